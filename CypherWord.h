@@ -7,7 +7,7 @@
 //
 
 // Apple Headers
-#import <Cocoa/Cocoa.h>
+#import <Foundation/Foundation.h>
 
 // System Headers
 
@@ -42,6 +42,8 @@
 	NSString*		_cyphertext;
 	NSUInteger		_cypherSize;
 	NSString*		_cypherPattern;
+	NSData*			_code;
+	uint32_t		_letterMask;
 }
 
 //----------------------------------------------------------------------------
@@ -90,6 +92,27 @@
  */
 - (NSString*) getCypherPattern;
 
+/*!
+ This method returns the cyphertext as letter codes - as described in
+ LetterCode.h - one byte per character. This is what the search works
+ with, as it's already case-folded, and there's no need to go through
+ the NSString for every character.
+
+ @param
+ @return The letter codes of the cyphertext - -length bytes
+ */
+- (const uint8_t*) getCode;
+
+/*!
+ This method returns the set of cyphertext characters in this word, as a
+ bit mask, with 'a' as bit 0, 'b' as bit 1, etc. If none of these are
+ changed in a legend, then this word's matches don't change either.
+
+ @param
+ @return The bit mask of the cyphertext characters in the word
+ */
+- (uint32_t) getLetterMask;
+
 //----------------------------------------------------------------------------
 //					Initialization Methods
 //----------------------------------------------------------------------------
@@ -154,6 +177,23 @@
  */
 - (NSString*) createPlaintextWithLegend:(Legend*)key;
 
+//----------------------------------------------------------------------------
+//					Letter Coding Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method fills in 'code' with the letter codes of the text - as they
+ are described in LetterCode.h. If the text isn't 'len' characters long,
+ then it can't match anything of that length, and so all the codes are
+ LC_NONE. This is done once for each word as the puzzle is built so that
+ the search never has to fold the case, or look at an NSString.
+
+ @param text The cyphertext, or plaintext, to encode
+ @param code The buffer of 'len' bytes to fill in
+ @param len The number of characters that the text needs to have
+ */
++ (void) encodeText:(NSString*)text into:(uint8_t*)code length:(NSUInteger)len;
+
 //----------------------------------------------------------------------------
 //					NSObject Overridden Methods
 //----------------------------------------------------------------------------
@@ -9,6 +9,7 @@
 // Apple Headers
 
 // System Headers
+#include <string.h>
 
 // Third Party Headers
 
@@ -16,6 +17,7 @@
 
 // Class Headers
 #import "CypherWord_Protected.h"
+#import "LetterCode.h"
 
 // Superclass Headers
 
@@ -101,6 +103,35 @@
 }
 
 
+/*!
+ This method returns the cyphertext as letter codes - as described in
+ LetterCode.h - one byte per character. This is what the search works
+ with, as it's already case-folded, and there's no need to go through
+ the NSString for every character.
+
+ @param
+ @return The letter codes of the cyphertext - -length bytes
+ */
+- (const uint8_t*) getCode
+{
+	return [_code bytes];
+}
+
+
+/*!
+ This method returns the set of cyphertext characters in this word, as a
+ bit mask, with 'a' as bit 0, 'b' as bit 1, etc. If none of these are
+ changed in a legend, then this word's matches don't change either.
+
+ @param
+ @return The bit mask of the cyphertext characters in the word
+ */
+- (uint32_t) getLetterMask
+{
+	return _letterMask;
+}
+
+
 //----------------------------------------------------------------------------
 //					Initialization Methods
 //----------------------------------------------------------------------------
@@ -172,20 +203,13 @@
 	 * Let's run through all the characters, and IF a cypher character is
 	 * mapped by the Legend, it had better map to the plaintext character
 	 * or else we don't have a match. As soon as we don't have a match, we
-	 * can quit looking.
+	 * can quit looking. This is done on the letter codes of the two words.
 	 */
 	if (match) {
-		unichar		plain;
 		NSUInteger	len = [plaintext length];
-		for (NSUInteger i = 0; (i < len) && match; ++i) {
-			// get the next possible pair in the two words
-			plain = [key plainCharForCypherChar:[[self getCypherText] characterAtIndex:i]];
-			// if it's mapped, then it had better match the plaintext
-			if ((plain != '\0') && (tolower(plain) != tolower([plaintext characterAtIndex:i]))) {
-				match = NO;
-				break;
-			}
-		}
+		uint8_t		plain[len];
+		[CypherWord encodeText:plaintext into:plain length:len];
+		match = lc_can_match([self getCode], plain, len, [key getMap]);
 	}
 	
 	return match;
@@ -223,17 +247,10 @@
 	 * don't have a match. As soon as we don't have a match, we can quit looking.
 	 */
 	if (match) {
-		unichar		plain;
 		NSUInteger	len = [plaintext length];
-		for (NSUInteger i = 0; (i < len) && match; ++i) {
-			// get the next possible pair in the two words
-			plain = [key plainCharForCypherChar:[[self getCypherText] characterAtIndex:i]];
-			// must be mapped, and match the plaintext
-			if ((plain == '\0') || (tolower(plain) != tolower([plaintext characterAtIndex:i]))) {
-				match = NO;
-				break;
-			}
-		}
+		uint8_t		plain[len];
+		[CypherWord encodeText:plaintext into:plain length:len];
+		match = lc_decodes_to([self getCode], plain, len, [key getMap]);
 	}
 	
 	return match;
@@ -254,6 +271,33 @@
 }
 
 
+//----------------------------------------------------------------------------
+//					Letter Coding Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method fills in 'code' with the letter codes of the text - as they
+ are described in LetterCode.h. If the text isn't 'len' characters long,
+ then it can't match anything of that length, and so all the codes are
+ LC_NONE. This is done once for each word as the puzzle is built so that
+ the search never has to fold the case, or look at an NSString.
+
+ @param text The cyphertext, or plaintext, to encode
+ @param code The buffer of 'len' bytes to fill in
+ @param len The number of characters that the text needs to have
+ */
++ (void) encodeText:(NSString*)text into:(uint8_t*)code length:(NSUInteger)len
+{
+	if ((text != nil) && ([text length] == len)) {
+		for (NSUInteger i = 0; i < len; ++i) {
+			code[i] = lc_encode([text characterAtIndex:i]);
+		}
+	} else {
+		memset(code, LC_NONE, len);
+	}
+}
+
+
 //----------------------------------------------------------------------------
 //					NSObject Overridden Methods
 //----------------------------------------------------------------------------
@@ -267,7 +311,7 @@
 {
 	BOOL	equal = NO;
 	if ([obj isKindOfClass:[self class]]) {
-		equal = [[self getCypherText] isEqual:obj];
+		equal = [[self getCypherText] isEqual:[obj getCypherText]];
 	}
 	return equal;
 }
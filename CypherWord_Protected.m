@@ -83,6 +83,18 @@
 	_cyphertext = text;
 	_cypherSize = [text length];
 	_cypherPattern = [CypherWord createPatternText:text];
+	// ...and make the letter codes the search will use
+	NSMutableData*	code = [NSMutableData dataWithLength:_cypherSize];
+	[CypherWord encodeText:text into:[code mutableBytes] length:_cypherSize];
+	_code = code;
+	// ...and the set of letters in it
+	_letterMask = 0;
+	const uint8_t*	c = [code bytes];
+	for (NSUInteger i = 0; i < _cypherSize; ++i) {
+		if (c[i] < 26) {
+			_letterMask |= (1u << c[i]);
+		}
+	}
 }
 
 @end
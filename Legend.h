@@ -7,7 +7,7 @@
 //
 
 // Apple Headers
-#import <Cocoa/Cocoa.h>
+#import <Foundation/Foundation.h>
 
 // System Headers
 
@@ -39,6 +39,12 @@
 @interface Legend : NSObject {
 @private
 	unichar		_map[26];
+	unichar		_reverse[26];
+	uint32_t	_plainMask;
+	uint32_t	_cypherMask;
+	uint64_t	_hash;
+	unichar		_trail[26];
+	NSUInteger	_trailLength;
 }
 
 //----------------------------------------------------------------------------
@@ -73,11 +79,47 @@
  */
 - (unichar*) getMap;
 
+/*!
+ This method returns the actual pointer to the 26 element unichar array
+ that's the reverse of -getMap: the position in the array is the plaintext
+ character's offset from 'a', and the value is the cyphertext character
+ that maps to it - or '\0' if nothing does. It's kept in step with the map
+ so you never have to go looking through the map for a plaintext character.
+
+ @param
+ @return The character array representing the reverse mapping
+ */
+- (unichar*) getReverseMap;
+
+/*!
+ This method returns the set of plaintext characters that are already the
+ target of some mapping in this legend, as a bit mask, with 'a' as bit 0,
+ 'b' as bit 1, etc. A plaintext character can only be used once, so this
+ is the single test for whether a new mapping would conflict.
+
+ @param
+ @return The bit mask of plaintext characters in use
+ */
+- (uint32_t) getPlainMask;
+
+/*!
+ This method returns the set of cyphertext characters that are mapped in
+ this legend, as a bit mask, with 'a' as bit 0, 'b' as bit 1, etc. The
+ difference between this before and after adding a word is exactly the
+ set of cypher characters that word bound - which is what the search needs
+ to know to see which other words are affected.
+
+ @param
+ @return The bit mask of cyphertext characters that are mapped
+ */
+- (uint32_t) getCypherMask;
+
 /*!
  This method sets the mapping in this legend for the provided pair of
  characters: the cypher character and the plain character. This will
  go into the legend and will be used in all subsequent decodings of
- cypherwords by this legend.
+ cypherwords by this legend. Any existing mapping of the cypher character,
+ or to the plain character, is replaced, so the legend is always valid.
 
  @param c The cypher character
  @param p The plain character
@@ -155,12 +197,29 @@
  we'll incorporate the mappings and return YES, if not, nothing it changed
  and NO is returned.
 
+ Every new mapping is added to the trail, so a caller can take a -getMark
+ before this, and -rollbackToMark: after it, to put the legend back just
+ the way it was - without having to make a copy of it.
+
  @param cyphertet The cyphertext to use as a sequence of mappings
  @param plaintext The plaintext to use as a sequence of mappings
  @return YES, if the mappings can be incorporated without conflict
  */
 - (BOOL) incorporateMappingCypher:(CypherWord*)cw toPlain:(NSString*)pw;
 
+/*!
+ This is the same as -incorporateMappingCypher:toPlain: but on the letter
+ codes of the cypherword and plaintext - as they are in LetterCode.h. This
+ is what the search uses, as the words are already coded, and there's no
+ need to look at an NSString, or fold the case of anything.
+
+ @param cw The letter codes of the cypherword
+ @param pw The letter codes of the plaintext
+ @param len The number of codes in each
+ @return YES, if the mappings can be incorporated without conflict
+ */
+- (BOOL) incorporateCode:(const uint8_t*)cw toPlain:(const uint8_t*)pw length:(NSUInteger)len;
+
 /*!
  This method takes a cyphertext and attempts to completely decode it into a
  plaintext using the mapping currently available. If it creates a completely
@@ -171,6 +230,30 @@
  */
 - (NSString*) decode:(NSString*)cyphertext;
 
+//----------------------------------------------------------------------------
+//					Trail Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the current position in the trail of mappings that
+ have been added by -incorporateMappingCypher:toPlain:. It's what you pass
+ to -rollbackToMark: to undo everything that's been added since. This is
+ how the search uses one legend for all its guesses, and never copies it.
+
+ @param
+ @return The mark to roll back to later
+ */
+- (NSUInteger) getMark;
+
+/*!
+ This method undoes all the mappings added to the legend since the mark
+ was taken with -getMark. There can only be 26 mappings in a legend, so
+ this is never much work, and it doesn't allocate a thing.
+
+ @param mark The value of -getMark to roll the legend back to
+ */
+- (void) rollbackToMark:(NSUInteger)mark;
+
 //----------------------------------------------------------------------------
 //					NSObject Overridden Methods
 //----------------------------------------------------------------------------
@@ -184,8 +267,9 @@
 
 /*!
  With a custom -isEquals: method, we need to compute a good hashcode for
- this map. We're going to make it as simple as we can - simply summing up
- the characters offsetting each by a factor of 31.
+ this map. Each possible mapping has a random 64-bit value, and the hash is
+ the XOR of the values of the mappings in the legend. That's kept up as the
+ mappings are added and removed, so this is just returning it.
  */
 - (NSUInteger) hash;
 
@@ -203,7 +287,8 @@
  This is the standard copy method for the Legend so that we can make
  clean copies without having to worry about all the details. It's a nice
  deep copy, where the contents of the returned Legend are the same as
- this instance's.
+ this instance's. The trail isn't copied - the copy starts with a mark of
+ zero, and can't be rolled back past the mappings it started with.
  */
 - (id) copyWithZone:(NSZone*)zone;
 
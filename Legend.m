@@ -18,6 +18,7 @@
 // Class Headers
 #import "Legend_Protected.h"
 #import "CypherWord.h"
+#import "LetterCode.h"
 
 // Superclass Headers
 
@@ -26,9 +27,36 @@
 // Private Data Types
 
 // Private Constants
+/*!
+ This is the seed for the table of random values used in the hash. It's
+ fixed so that the hash of a legend is the same from run to run, which
+ makes it a lot easier to compare logs and cached results.
+ */
+#define ZOBRIST_SEED	0x9e3779b97f4a7c15ULL
 
 // Private Macros
 
+
+/*
+ * This is the table of random values for each mapping - by cypher, and then
+ * plain, character. The hash of a legend is the XOR of the values for each
+ * of its mappings, so adding, or removing, a mapping is a single XOR.
+ */
+static uint64_t	__zobrist[26][26];
+
+
+/*
+ * This is the splitmix64 generator - small, fast, and plenty good enough
+ * to fill in the table of random values for the hash.
+ */
+static uint64_t splitmix64(uint64_t* state)
+{
+	uint64_t	z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
 /*!
  @class Legend 
  This class holds the 'legend' or mapping of the cyphertext characters
@@ -38,6 +66,56 @@
  */
 @implementation Legend
 
+/*
+ * These are the only two ways the mapping changes - a cypher slot is bound
+ * to a plain slot, or it's unbound. Everything goes through these so that
+ * the map, the reverse map, the mask, and the hash all stay in step.
+ */
+static inline void bindSlots(__unsafe_unretained Legend* key, int c, int p)
+{
+	key->_map[c] = 'a' + p;
+	key->_reverse[p] = 'a' + c;
+	key->_plainMask |= (1u << p);
+	key->_cypherMask |= (1u << c);
+	key->_hash ^= __zobrist[c][p];
+}
+
+
+static inline void unbindSlot(__unsafe_unretained Legend* key, int c)
+{
+	if (key->_map[c] != '\0') {
+		int		p = key->_map[c] - 'a';
+		key->_map[c] = '\0';
+		key->_reverse[p] = '\0';
+		key->_plainMask &= ~(1u << p);
+		key->_cypherMask &= ~(1u << c);
+		key->_hash ^= __zobrist[c][p];
+	}
+}
+
+
+//----------------------------------------------------------------------------
+//					Class Initialization Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method is called when the class is initialized and we're going to
+ take this opportunity to fill in the table of random values for each of
+ the possible mappings that makes up the hash of a legend.
+ */
++ (void) initialize
+{
+	if (self == [Legend class]) {
+		uint64_t	state = ZOBRIST_SEED;
+		for (int c = 0; c < 26; ++c) {
+			for (int p = 0; p < 26; ++p) {
+				__zobrist[c][p] = splitmix64(&state);
+			}
+		}
+	}
+}
+
+
 //----------------------------------------------------------------------------
 //					Creation Methods
 //----------------------------------------------------------------------------
@@ -79,6 +157,53 @@
 }
 
 
+/*!
+ This method returns the actual pointer to the 26 element unichar array
+ that's the reverse of -getMap: the position in the array is the plaintext
+ character's offset from 'a', and the value is the cyphertext character
+ that maps to it - or '\0' if nothing does. It's kept in step with the map
+ so you never have to go looking through the map for a plaintext character.
+
+ @param
+ @return The character array representing the reverse mapping
+ */
+- (unichar*) getReverseMap
+{
+	return _reverse;
+}
+
+
+/*!
+ This method returns the set of plaintext characters that are already the
+ target of some mapping in this legend, as a bit mask, with 'a' as bit 0,
+ 'b' as bit 1, etc. A plaintext character can only be used once, so this
+ is the single test for whether a new mapping would conflict.
+
+ @param
+ @return The bit mask of plaintext characters in use
+ */
+- (uint32_t) getPlainMask
+{
+	return _plainMask;
+}
+
+
+/*!
+ This method returns the set of cyphertext characters that are mapped in
+ this legend, as a bit mask, with 'a' as bit 0, 'b' as bit 1, etc. The
+ difference between this before and after adding a word is exactly the
+ set of cypher characters that word bound - which is what the search needs
+ to know to see which other words are affected.
+
+ @param
+ @return The bit mask of cyphertext characters that are mapped
+ */
+- (uint32_t) getCypherMask
+{
+	return _cypherMask;
+}
+
+
 /*!
  This method sets the mapping in this legend for the provided pair of
  characters: the cypher character and the plain character. This will
@@ -91,7 +216,14 @@
 - (void) mapCypherChar:(unichar)c toPlainChar:(unichar)p
 {
 	if (isalpha(c) && isalpha(p)) {
-		_map[toupper(c) - 'A'] = tolower(p);
+		int		cs = toupper(c) - 'A';
+		int		ps = tolower(p) - 'a';
+		// clear out anything in the way of the new mapping
+		unbindSlot(self, cs);
+		if (_reverse[ps] != '\0') {
+			unbindSlot(self, _reverse[ps] - 'a');
+		}
+		bindSlots(self, cs, ps);
 	}
 }
 
@@ -108,7 +240,7 @@
 - (void) unmapCypherChar:(unichar)c
 {
 	if (isalpha(c)) {
-		_map[toupper(c) - 'A'] = '\0';
+		unbindSlot(self, toupper(c) - 'A');
 	}
 }
 
@@ -195,13 +327,13 @@
 {
 	// assume that we're NOT going to be able to map this guy
 	unichar	retval = '\0';
-	// we're going to search for the lower-case version of the plaintext
-	unichar	pt = tolower(p);
-	for (int i = 0; i < 26; ++i) {
-		if (_map[i] == pt) {
-			// we found it - construct it and get it in the right case
-			retval = (i + 'a') + (isupper(p) ? ('A' - 'a') : 0);
-			break;
+	// we're only going to map the alphabet - regardless of case
+	if (isalpha(p)) {
+		// look for it in the reverse map
+		retval = _reverse[tolower(p) - 'a'];
+		// if it's there, then match the case of the plaintext char
+		if ((retval != '\0') && isupper(p)) {
+			retval += ('A' - 'a');
 		}
 	}
 	return retval;
@@ -223,47 +355,67 @@
  */
 - (BOOL) incorporateMappingCypher:(CypherWord*)cw toPlain:(NSString*)pw
 {
-	BOOL	error = NO;
+	BOOL	ok = YES;
 	
 	// make sure there's something to work with
 	if ((cw != nil) && (pw != nil) && ([cw length] == [pw length])) {
-		// make a copy of the existing map in case we fail
-		unichar	backup[26];
-		memcpy(backup, [self getMap], sizeof(backup));
-
-		// process every pair of characters in the cypher/plaintext pair
-		unichar	cc, pc;
-		for (int i = 0; !error && (i < [cw length]); ++i) {
-			// get the individual characters from the texts
-			cc = tolower([[cw getCypherText] characterAtIndex:i]);
-			pc = tolower([pw characterAtIndex:i]);
-			
-			// check for punctuation - it's gotta match, but it's not mapped
-			if (ispunct(cc) || ispunct(pc)) {
-				error = (cc != pc);
-				continue;
-			}
-			
-			// see if either side of the mapping already exists
-			if ([self getMap][cc - 'a'] != '\0') {
-				error = ([self getMap][cc - 'a'] != pc);
-			} else {
-				// see if the plaintext character is already mapped
-				for (int j = 0; !error && (j < 26); ++j) {
-					error = ([self getMap][j] == pc);
-				}
-			}
-			
-			// OK... new, valid, mapping data. Let's save it...
+		// get the letter codes of the plaintext, and use them
+		NSUInteger	len = [pw length];
+		uint8_t		plain[len];
+		[CypherWord encodeText:pw into:plain length:len];
+		ok = [self incorporateCode:[cw getCode] toPlain:plain length:len];
+	}
+
+	return ok;
+}
+
+
+/*!
+ This is the same as -incorporateMappingCypher:toPlain: but on the letter
+ codes of the cypherword and plaintext - as they are in LetterCode.h. This
+ is what the search uses, as the words are already coded, and there's no
+ need to look at an NSString, or fold the case of anything.
+
+ @param cw The letter codes of the cypherword
+ @param pw The letter codes of the plaintext
+ @param len The number of codes in each
+ @return YES, if the mappings can be incorporated without conflict
+ */
+- (BOOL) incorporateCode:(const uint8_t*)cw toPlain:(const uint8_t*)pw length:(NSUInteger)len
+{
+	BOOL		error = NO;
+	// remember where we started in case we fail
+	NSUInteger	mark = [self getMark];
+
+	// process every pair of characters in the cypher/plaintext pair
+	uint8_t		cc, pc;
+	for (NSUInteger i = 0; !error && (i < len); ++i) {
+		cc = cw[i];
+		pc = pw[i];
+
+		// check for punctuation - it's gotta match, but it's not mapped
+		if ((cc | pc) & LC_PUNCT) {
+			error = ((cc != pc) || (cc == LC_NONE));
+			continue;
+		}
+
+		// see if either side of the mapping already exists
+		if (_map[cc] != '\0') {
+			error = (_map[cc] != 'a' + pc);
+		} else {
+			// see if the plaintext character is already mapped
+			error = ((_plainMask & (1u << pc)) != 0);
+			// OK... new, valid, mapping data. Let's save it, and trail it
 			if (!error) {
-				[self mapCypherChar:cc toPlainChar:pc];
+				bindSlots(self, cc, pc);
+				_trail[_trailLength++] = cc;
 			}
 		}
-		
-		// is we had an error, copy BACK the original mapping data
-		if (error) {
-			memcpy([self getMap], backup, sizeof(backup));
-		}
+	}
+
+	// if we had an error, undo what we added
+	if (error) {
+		[self rollbackToMark:mark];
 	}
 
 	return !error;
@@ -311,6 +463,40 @@
 }
 
 
+//----------------------------------------------------------------------------
+//					Trail Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the current position in the trail of mappings that
+ have been added by -incorporateMappingCypher:toPlain:. It's what you pass
+ to -rollbackToMark: to undo everything that's been added since. This is
+ how the search uses one legend for all its guesses, and never copies it.
+
+ @param
+ @return The mark to roll back to later
+ */
+- (NSUInteger) getMark
+{
+	return _trailLength;
+}
+
+
+/*!
+ This method undoes all the mappings added to the legend since the mark
+ was taken with -getMark. There can only be 26 mappings in a legend, so
+ this is never much work, and it doesn't allocate a thing.
+
+ @param mark The value of -getMark to roll the legend back to
+ */
+- (void) rollbackToMark:(NSUInteger)mark
+{
+	while (_trailLength > mark) {
+		unbindSlot(self, _trail[--_trailLength]);
+	}
+}
+
+
 //----------------------------------------------------------------------------
 //					NSObject Overridden Methods
 //----------------------------------------------------------------------------
@@ -324,7 +510,9 @@
 {
 	BOOL	equal = NO;
 	if ([obj isKindOfClass:[self class]]) {
-		equal = (memcmp([self getMap], [obj getMap], sizeof(_map)) == 0);
+		// the hashes are cheap to check, and are different most of the time
+		equal = (([self hash] == [obj hash]) &&
+				 (memcmp([self getMap], [obj getMap], sizeof(_map)) == 0));
 	}
 	return equal;
 }
@@ -332,16 +520,13 @@
 
 /*!
  With a custom -isEquals: method, we need to compute a good hashcode for
- this map. We're going to make it as simple as we can - simply summing up
- the characters offsetting each by a factor of 31.
+ this map. Each possible mapping has a random 64-bit value, and the hash is
+ the XOR of the values of the mappings in the legend. That's kept up as the
+ mappings are added and removed, so this is just returning it.
  */
 - (NSUInteger) hash
 {
-	NSUInteger	hash = 0;
-	for (int i = 0; i < 26; ++i) {
-		hash = 31*hash + (_map[i] - 'a');
-	}
-	return hash;
+	return (NSUInteger)_hash;
 }
 
 
@@ -375,7 +560,8 @@
  This is the standard copy method for the Legend so that we can make
  clean copies without having to worry about all the details. It's a nice
  deep copy, where the contents of the returned Legend are the same as
- this instance's.
+ this instance's. The trail isn't copied - the copy starts with a mark of
+ zero, and can't be rolled back past the mappings it started with.
  */
 - (id) copyWithZone:(NSZone*)zone
 {
@@ -53,7 +53,19 @@
 - (void) setMap:(unichar*)map
 {
 	if (map != NULL) {
-		memcpy(_map, map, sizeof(_map));
+		// start clean - the trail is for the old map, so it's no good anymore
+		memset(_map, 0, sizeof(_map));
+		memset(_reverse, 0, sizeof(_reverse));
+		_plainMask = 0;
+		_cypherMask = 0;
+		_hash = 0;
+		_trailLength = 0;
+		// ...and add in each mapping so it all stays in step
+		for (int i = 0; i < 26; ++i) {
+			if (map[i] != '\0') {
+				[self mapCypherChar:('a' + i) toPlainChar:map[i]];
+			}
+		}
 	}
 }
 
@@ -0,0 +1,98 @@
+//
+//  LetterCode.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/10/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+#ifndef __LETTERCODE_H
+#define __LETTERCODE_H
+
+// System Headers
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * This is the form the cypherwords, and their possible plaintexts, are in
+ * when we're searching. Each character is one byte: a letter - of either
+ * case - is its offset from 'a', 0 to 25, and anything else is the ASCII
+ * character with the high bit set, so it has to match exactly, and is never
+ * mapped. Everything is folded and checked once, when the puzzle is built,
+ * so the matching in the search is a tight loop over bytes, and the legend
+ * is just the 26 element map - indexed by the cypher letter.
+ */
+
+// Public Constants
+#define LC_PUNCT			0x80
+#define LC_NONE				0xff
+
+/*
+ * This function returns the code for the character. Non-ASCII characters
+ * are LC_NONE, which never matches anything - not even itself.
+ */
+static inline uint8_t lc_encode(uint32_t c)
+{
+	uint8_t		code = LC_NONE;
+	if ((c >= 'a') && (c <= 'z')) {
+		code = (uint8_t)(c - 'a');
+	} else if ((c >= 'A') && (c <= 'Z')) {
+		code = (uint8_t)(c - 'A');
+	} else if (c < 0x7f) {
+		code = (uint8_t)(LC_PUNCT | c);
+	}
+	return code;
+}
+
+/*
+ * This function returns 1 if the coded cypherword 'cw' could decode to the
+ * coded plaintext 'pw' under the 'map' - every mapped letter maps to the
+ * plaintext letter, and the rest is the same. 'map' is the 26 element map
+ * of a Legend, where '\0' is unmapped.
+ */
+static inline int lc_can_match(const uint8_t* cw, const uint8_t* pw, size_t len, const uint16_t* map)
+{
+	for (size_t i = 0; i < len; ++i) {
+		uint8_t		c = cw[i];
+		uint8_t		p = pw[i];
+		if ((c | p) & LC_PUNCT) {
+			if ((c != p) || (c == LC_NONE)) {
+				return 0;
+			}
+		} else if ((map[c] != 0) && (map[c] != 'a' + p)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * This function returns 1 if the coded cypherword 'cw' decodes to exactly
+ * the coded plaintext 'pw' under the 'map' - every letter is mapped, and
+ * to the plaintext letter.
+ */
+static inline int lc_decodes_to(const uint8_t* cw, const uint8_t* pw, size_t len, const uint16_t* map)
+{
+	for (size_t i = 0; i < len; ++i) {
+		uint8_t		c = cw[i];
+		uint8_t		p = pw[i];
+		if ((c | p) & LC_PUNCT) {
+			if ((c != p) || (c == LC_NONE)) {
+				return 0;
+			}
+		} else if (map[c] != 'a' + p) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// __LETTERCODE_H
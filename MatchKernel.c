@@ -0,0 +1,586 @@
+//
+//  MatchKernel.c
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/12/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// System Headers
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MK_X86	1
+#endif
+
+// Other Headers
+#include "MatchKernel.h"
+#include "LetterCode.h"
+
+// Private Data Types
+/*
+ * This is what all the versions of the filter get: the columns to check,
+ * and for each of the 'checks', the column and the code it has to have -
+ * or MK_ANY_LETTER if it just has to be a letter, and not punctuation.
+ * If 'narrow' is set, the mask already has the possibles to check, and
+ * the blocks with nothing left in them are skipped.
+ */
+typedef void (*MKFilterFunc)(const MKColumns* cols, const uint32_t* pos, const uint8_t* want, uint32_t checks, int narrow, uint64_t* mask);
+
+// Private Constants
+#define COLUMN_ALIGNMENT	32
+#define BITSET_CODES		27
+#define BITSET_ANY_LETTER	26
+
+
+/*
+ * This function builds the columns from 'count' possibles of 'length'
+ * letter codes each, stored back to back in 'rows' - as they are in a
+ * PuzzlePiece - along with the masks of each letter in each column, and
+ * the set of the letters in each possible. The padding at the end of each
+ * column is LC_NONE so it never matches. Returns 0, or an errno value if
+ * the columns can't be allocated. If it's only the masks, or the sets,
+ * that can't be, they are left out - the filter compares codes, and the
+ * legend catches the letters that are already taken.
+ */
+int mk_build(MKColumns* cols, const uint8_t* rows, uint32_t count, uint32_t length)
+{
+	memset(cols, 0, sizeof(MKColumns));
+	cols->count = count;
+	cols->length = length;
+	cols->stride = (uint32_t)(mk_mask_words(count) * MK_BLOCK);
+
+	size_t		size = (size_t)cols->stride * length;
+	if (size > 0) {
+		void*	buff = NULL;
+		if (posix_memalign(&buff, COLUMN_ALIGNMENT, size) != 0) {
+			memset(cols, 0, sizeof(MKColumns));
+			return ENOMEM;
+		}
+		cols->columns = buff;
+		cols->mixed = calloc(length, 1);
+		if (cols->mixed == NULL) {
+			mk_free(cols);
+			return ENOMEM;
+		}
+		memset(cols->columns, LC_NONE, size);
+		// transpose the rows into the columns, and note the non-letters
+		for (uint32_t i = 0; i < count; ++i) {
+			const uint8_t*	row = rows + (size_t)i * length;
+			for (uint32_t j = 0; j < length; ++j) {
+				cols->columns[(size_t)j * cols->stride + i] = row[j];
+				if (row[j] & LC_PUNCT) {
+					cols->mixed[j] = 1;
+				}
+			}
+		}
+		/*
+		 * The masks are BITSET_CODES for each column, each of them a word
+		 * for each block - so the masks of one letter in one column are
+		 * all together, in block order, just as the filter walks them.
+		 */
+		size_t		words = mk_mask_words(count);
+		cols->bits = calloc((size_t)length * BITSET_CODES * words, sizeof(uint64_t));
+		if (cols->bits != NULL) {
+			for (uint32_t j = 0; j < length; ++j) {
+				uint64_t*		col = cols->bits + (size_t)j * BITSET_CODES * words;
+				const uint8_t*	codes = cols->columns + (size_t)j * cols->stride;
+				for (uint32_t i = 0; i < count; ++i) {
+					uint64_t	bit = 1ULL << (i % MK_BLOCK);
+					if ((codes[i] & LC_PUNCT) == 0) {
+						col[(size_t)codes[i] * words + i / MK_BLOCK] |= bit;
+						col[(size_t)BITSET_ANY_LETTER * words + i / MK_BLOCK] |= bit;
+					}
+				}
+			}
+		}
+		// ...and the set of the letters each possible uses
+		cols->letters = calloc(count > 0 ? count : 1, sizeof(uint32_t));
+		if (cols->letters != NULL) {
+			for (uint32_t i = 0; i < count; ++i) {
+				const uint8_t*	row = rows + (size_t)i * length;
+				for (uint32_t j = 0; j < length; ++j) {
+					if ((row[j] & LC_PUNCT) == 0) {
+						cols->letters[i] |= (1u << row[j]);
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * This function frees up the columns, and clears out the struct so that
+ * it's safe to free it again.
+ */
+void mk_free(MKColumns* cols)
+{
+	if (cols != NULL) {
+		free(cols->columns);
+		free(cols->mixed);
+		free(cols->bits);
+		free(cols->letters);
+		memset(cols, 0, sizeof(MKColumns));
+	}
+}
+
+
+/*
+ * This is the plain C version of the filter - one block of possibles at a
+ * time, and within that, one check at a time, so that we can stop on the
+ * block as soon as nothing in it is left - or skip it if it starts empty.
+ */
+static void filterScalar(const MKColumns* cols, const uint32_t* pos, const uint8_t* want, uint32_t checks, int narrow, uint64_t* mask)
+{
+	size_t		blocks = cols->stride / MK_BLOCK;
+	for (size_t b = 0; b < blocks; ++b) {
+		uint64_t	m = (narrow ? mask[b] : ~0ULL);
+		for (uint32_t k = 0; (k < checks) && (m != 0); ++k) {
+			const uint8_t*	col = cols->columns + (size_t)pos[k] * cols->stride + b * MK_BLOCK;
+			uint64_t		bits = 0;
+			if (want[k] == MK_ANY_LETTER) {
+				for (uint32_t i = 0; i < MK_BLOCK; ++i) {
+					bits |= (uint64_t)((col[i] & LC_PUNCT) == 0) << i;
+				}
+			} else {
+				for (uint32_t i = 0; i < MK_BLOCK; ++i) {
+					bits |= (uint64_t)(col[i] == want[k]) << i;
+				}
+			}
+			m &= bits;
+		}
+		mask[b] = m;
+	}
+}
+
+
+#ifdef MK_X86
+/*
+ * This is the SSE2 version of the filter - each check of a block is four
+ * 16-byte compares, and each compare gives 16 bits of the mask. The codes
+ * of the letters are the ones without the high bit, so checking for any
+ * letter is just the inverse of the movemask of the codes themselves.
+ */
+__attribute__((target("sse2")))
+static void filterSSE2(const MKColumns* cols, const uint32_t* pos, const uint8_t* want, uint32_t checks, int narrow, uint64_t* mask)
+{
+	size_t		blocks = cols->stride / MK_BLOCK;
+	for (size_t b = 0; b < blocks; ++b) {
+		uint64_t	m = (narrow ? mask[b] : ~0ULL);
+		for (uint32_t k = 0; (k < checks) && (m != 0); ++k) {
+			const __m128i*	col = (const __m128i*)(cols->columns + (size_t)pos[k] * cols->stride + b * MK_BLOCK);
+			uint64_t		b0, b1, b2, b3;
+			if (want[k] == MK_ANY_LETTER) {
+				b0 = (uint16_t)_mm_movemask_epi8(_mm_load_si128(col));
+				b1 = (uint16_t)_mm_movemask_epi8(_mm_load_si128(col + 1));
+				b2 = (uint16_t)_mm_movemask_epi8(_mm_load_si128(col + 2));
+				b3 = (uint16_t)_mm_movemask_epi8(_mm_load_si128(col + 3));
+				m &= ~(b0 | (b1 << 16) | (b2 << 32) | (b3 << 48));
+			} else {
+				__m128i		w = _mm_set1_epi8((char)want[k]);
+				b0 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(col), w));
+				b1 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(col + 1), w));
+				b2 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(col + 2), w));
+				b3 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(col + 3), w));
+				m &= b0 | (b1 << 16) | (b2 << 32) | (b3 << 48);
+			}
+		}
+		mask[b] = m;
+	}
+}
+
+
+/*
+ * This is the AVX2 version of the filter - each check of a block is two
+ * 32-byte compares, and each compare gives 32 bits of the mask.
+ */
+__attribute__((target("avx2")))
+static void filterAVX2(const MKColumns* cols, const uint32_t* pos, const uint8_t* want, uint32_t checks, int narrow, uint64_t* mask)
+{
+	size_t		blocks = cols->stride / MK_BLOCK;
+	for (size_t b = 0; b < blocks; ++b) {
+		uint64_t	m = (narrow ? mask[b] : ~0ULL);
+		for (uint32_t k = 0; (k < checks) && (m != 0); ++k) {
+			const __m256i*	col = (const __m256i*)(cols->columns + (size_t)pos[k] * cols->stride + b * MK_BLOCK);
+			uint64_t		lo, hi;
+			if (want[k] == MK_ANY_LETTER) {
+				lo = (uint32_t)_mm256_movemask_epi8(_mm256_load_si256(col));
+				hi = (uint32_t)_mm256_movemask_epi8(_mm256_load_si256(col + 1));
+				m &= ~(lo | (hi << 32));
+			} else {
+				__m256i		w = _mm256_set1_epi8((char)want[k]);
+				lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(col), w));
+				hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(col + 1), w));
+				m &= lo | (hi << 32);
+			}
+		}
+		mask[b] = m;
+	}
+}
+#endif
+
+
+/*
+ * This is the filter on the masks of the letters in each column - for each
+ * block, it's just the AND of the mask of each check, and it stops on the
+ * block as soon as nothing in it is left. The checks can only be letters,
+ * or MK_ANY_LETTER - the punctuation has to be compared.
+ */
+static void filterBitsets(const MKColumns* cols, const uint32_t* pos, const uint8_t* want, uint32_t checks, int narrow, uint64_t* mask)
+{
+	size_t			words = mk_mask_words(cols->count);
+	const uint64_t*	sets[checks > 0 ? checks : 1];
+	for (uint32_t k = 0; k < checks; ++k) {
+		uint32_t	code = (want[k] == MK_ANY_LETTER ? BITSET_ANY_LETTER : want[k]);
+		sets[k] = cols->bits + ((size_t)pos[k] * BITSET_CODES + code) * words;
+	}
+	for (size_t b = 0; b < words; ++b) {
+		uint64_t	m = (narrow ? mask[b] : ~0ULL);
+		for (uint32_t k = 0; (k < checks) && (m != 0); ++k) {
+			m &= sets[k][b];
+		}
+		mask[b] = m;
+	}
+}
+
+
+/*
+ * This function picks the best version of the filter that this CPU can
+ * run. It's only done once, and if two threads race to do it, they will
+ * both come up with the same answer, so there's no harm.
+ */
+static MKFilterFunc		__filter = NULL;
+static const char*		__filterName = NULL;
+
+static MKFilterFunc pickFilter(void)
+{
+	if (__filter == NULL) {
+		MKFilterFunc	func = filterScalar;
+		const char*		name = "scalar";
+#ifdef MK_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			func = filterAVX2;
+			name = "avx2";
+		} else if (__builtin_cpu_supports("sse2")) {
+			func = filterSSE2;
+			name = "sse2";
+		}
+#endif
+		__filterName = name;
+		__filter = func;
+	}
+	return __filter;
+}
+
+
+/*
+ * This function does the work of mk_filter() and mk_narrow() - they only
+ * differ in whether what's in 'mask' on the way in counts for anything.
+ */
+static uint32_t runFilter(const MKColumns* cols, const uint8_t* cw, const uint16_t* map, int narrow, uint64_t* mask)
+{
+	size_t		words = mk_mask_words(cols->count);
+	uint32_t	total = 0;
+
+	/*
+	 * Only the columns where the cypherword has punctuation, or a letter
+	 * the legend has mapped, or an unmapped letter where some possibles
+	 * have punctuation, can rule anything out - so make the list of those,
+	 * and what the possibles need to have there. A cypherword with a
+	 * character we can't code can't match anything at all.
+	 */
+	uint32_t	pos[cols->length > 0 ? cols->length : 1];
+	uint8_t		want[cols->length > 0 ? cols->length : 1];
+	uint32_t	checks = 0;
+	int			hopeless = 0;
+	uint32_t	own = 0;
+	for (uint32_t j = 0; j < cols->length; ++j) {
+		uint8_t		c = cw[j];
+		if (c == LC_NONE) {
+			hopeless = 1;
+		} else if (c & LC_PUNCT) {
+			pos[checks] = j;
+			want[checks++] = c;
+		} else {
+			own |= (1u << c);
+			if (map[c] != 0) {
+				pos[checks] = j;
+				want[checks++] = (uint8_t)(map[c] - 'a');
+			} else if ((cols->mixed != NULL) && cols->mixed[j]) {
+				pos[checks] = j;
+				want[checks++] = MK_ANY_LETTER;
+			}
+		}
+	}
+
+	/*
+	 * The plaintext letters the legend has given to cypher letters that
+	 * aren't in the cypherword can't be in the possible at all - it would
+	 * need a second cypher letter for them - so any possible that uses one
+	 * of them is out, and its set of letters says so with one AND.
+	 */
+	uint32_t	taken = 0;
+	for (uint32_t c = 0; c < 26; ++c) {
+		if ((map[c] != 0) && ((own & (1u << c)) == 0)) {
+			taken |= (1u << (map[c] - 'a'));
+		}
+	}
+
+	if (hopeless) {
+		memset(mask, 0, words * sizeof(uint64_t));
+	} else if (words > 0) {
+		if (cols->bits == NULL) {
+			pickFilter()(cols, pos, want, checks, narrow, mask);
+		} else {
+			/*
+			 * The punctuation has to be compared, but it's rare, so do that
+			 * first, if there is any, and then narrow what's left with the
+			 * masks of the letters.
+			 */
+			uint32_t	letters = 0;
+			uint32_t	punct = 0;
+			uint32_t	ppos[checks > 0 ? checks : 1];
+			uint8_t		pwant[checks > 0 ? checks : 1];
+			for (uint32_t k = 0; k < checks; ++k) {
+				if ((want[k] != MK_ANY_LETTER) && (want[k] & LC_PUNCT)) {
+					ppos[punct] = pos[k];
+					pwant[punct++] = want[k];
+				} else {
+					pos[letters] = pos[k];
+					want[letters++] = want[k];
+				}
+			}
+			if (punct > 0) {
+				pickFilter()(cols, ppos, pwant, punct, narrow, mask);
+			}
+			filterBitsets(cols, pos, want, letters, (narrow || (punct > 0)), mask);
+		}
+		// the padding only matches when there's nothing to check - clear it
+		if (cols->count % MK_BLOCK) {
+			mask[words - 1] &= (1ULL << (cols->count % MK_BLOCK)) - 1;
+		}
+		// ...and drop the ones that need a letter that's already taken
+		if ((taken != 0) && (cols->letters != NULL)) {
+			for (size_t b = 0; b < words; ++b) {
+				for (uint64_t bits = mask[b]; bits != 0; bits &= (bits - 1)) {
+					uint32_t	i = (uint32_t)(b * MK_BLOCK + __builtin_ctzll(bits));
+					if (cols->letters[i] & taken) {
+						mask[b] &= ~(1ULL << (i % MK_BLOCK));
+					}
+				}
+			}
+		}
+		for (size_t b = 0; b < words; ++b) {
+			total += (uint32_t)__builtin_popcountll(mask[b]);
+		}
+	}
+
+	return total;
+}
+
+
+/*
+ * This function sets bit i of 'mask' if possible i could be the decoding
+ * of the coded cypherword 'cw' under the legend's 'map' - the 26 element
+ * map where '\0' is unmapped - and clears it if not. It's also cleared if
+ * the possible needs a plaintext letter that the map has for a cypher
+ * letter that's not in the cypherword. 'mask' needs to have mk_mask_words()
+ * words. The count of the set bits is returned.
+ */
+uint32_t mk_filter(const MKColumns* cols, const uint8_t* cw, const uint16_t* map, uint64_t* mask)
+{
+	return runFilter(cols, cw, map, 0, mask);
+}
+
+
+/*
+ * This function is mk_filter() for a 'mask' that's already been filtered
+ * with a legend that 'map' only adds to - it clears the bits of the ones
+ * that can't match any longer, and only looks at the blocks that have some
+ * bits still set, so it gets cheaper as the possibles are whittled down.
+ * The count of the set bits left is returned.
+ */
+uint32_t mk_narrow(const MKColumns* cols, const uint8_t* cw, const uint16_t* map, uint64_t* mask)
+{
+	return runFilter(cols, cw, map, 1, mask);
+}
+
+
+/*
+ * This function explains why the possibles that aren't in 'live' - as
+ * mk_filter() left it for the coded cypherword 'cw' under the 'map' - were
+ * ruled out. 'levels' says, for each mapped cypher letter, the level of the
+ * search that mapped it - or MK_NO_LEVEL if it's part of the hint, and so
+ * can't be undone. What comes back is the set of the levels whose letters
+ * ruled them out, as a mask, with bit n for level n. Each possible is put
+ * down to the earliest level that rules it out, with the hint before them
+ * all, so the set is as shallow as it can be. The ones that can't match no
+ * matter what the legend says are no level's fault. If there are no masks
+ * of the letters in the columns, or if some possible can't be explained,
+ * this returns MK_UNEXPLAINED - every level is to blame.
+ */
+uint64_t mk_explain(const MKColumns* cols, const uint8_t* cw, const uint16_t* map, const uint8_t* levels, const uint64_t* live)
+{
+	size_t		words = mk_mask_words(cols->count);
+	if (words == 0) {
+		return 0;
+	}
+	if (cols->bits == NULL) {
+		return MK_UNEXPLAINED;
+	}
+
+	// the ones that can't match with nothing mapped aren't anyone's fault
+	uint64_t	rejected[words];
+	uint64_t	ruled[words];
+	uint16_t	none[26];
+	memset(none, 0, sizeof(none));
+	runFilter(cols, cw, none, 0, rejected);
+	uint32_t	own = 0;
+	for (uint32_t j = 0; j < cols->length; ++j) {
+		if ((cw[j] & LC_PUNCT) == 0) {
+			own |= (1u << cw[j]);
+		}
+	}
+	for (size_t b = 0; b < words; ++b) {
+		rejected[b] &= ~live[b];
+	}
+
+	/*
+	 * Go through the levels that mapped a letter - the hint first - and
+	 * put down to each level the ones its letters rule out that nothing
+	 * before it did. A letter in the cypherword rules out the possibles
+	 * that don't have its plaintext letter everywhere it is, and one that
+	 * isn't rules out the ones that use its plaintext letter at all.
+	 */
+	uint64_t	pending = 0;
+	for (uint32_t c = 0; c < 26; ++c) {
+		if ((map[c] != 0) && (levels[c] < 64)) {
+			pending |= (1ULL << levels[c]);
+		}
+	}
+	uint64_t	blame = 0;
+	int			left = 1;
+	for (int hint = 1; left && (hint || (pending != 0)); hint = 0) {
+		uint32_t	level = (hint ? MK_NO_LEVEL : (uint32_t)__builtin_ctzll(pending));
+		memset(ruled, 0, sizeof(ruled));
+		for (uint32_t c = 0; c < 26; ++c) {
+			if ((map[c] == 0) || ((levels[c] < 64 ? levels[c] : MK_NO_LEVEL) != level)) {
+				continue;
+			}
+			uint32_t	p = map[c] - 'a';
+			if (own & (1u << c)) {
+				for (size_t b = 0; b < words; ++b) {
+					uint64_t	fits = ~0ULL;
+					for (uint32_t j = 0; j < cols->length; ++j) {
+						if (cw[j] == c) {
+							fits &= cols->bits[((size_t)j * BITSET_CODES + p) * words + b];
+						}
+					}
+					ruled[b] |= ~fits;
+				}
+			} else {
+				for (uint32_t j = 0; j < cols->length; ++j) {
+					const uint64_t*	uses = cols->bits + ((size_t)j * BITSET_CODES + p) * words;
+					for (size_t b = 0; b < words; ++b) {
+						ruled[b] |= uses[b];
+					}
+				}
+			}
+		}
+		uint64_t	any = 0;
+		left = 0;
+		for (size_t b = 0; b < words; ++b) {
+			any |= rejected[b] & ruled[b];
+			rejected[b] &= ~ruled[b];
+			left |= (rejected[b] != 0);
+		}
+		if (!hint) {
+			if (any) {
+				blame |= (1ULL << level);
+			}
+			pending &= (pending - 1);
+		}
+	}
+
+	return (left ? MK_UNEXPLAINED : blame);
+}
+
+
+/*
+ * This function builds the table of the 'count' possibles of the first
+ * piece - 'length' letter codes each, back to back in 'rows' - for the
+ * coded cypherword 'cw', against the columns of the possibles of the other
+ * piece, and its coded cypherword 'ocw'. Each row is just the filter of the
+ * other piece with the legend that the one possible would make. Returns 0,
+ * or an errno value if the table can't be allocated.
+ */
+int mk_pair_build(MKPairTable* table, const uint8_t* rows, uint32_t count, uint32_t length, const uint8_t* cw, const MKColumns* other, const uint8_t* ocw)
+{
+	memset(table, 0, sizeof(MKPairTable));
+	table->rows = count;
+	table->words = (uint32_t)mk_mask_words(other->count);
+	// the filter writes a whole mask, so even an empty one needs a word
+	table->bits = calloc((size_t)count * table->words + 1, sizeof(uint64_t));
+	if (table->bits == NULL) {
+		memset(table, 0, sizeof(MKPairTable));
+		return ENOMEM;
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		const uint8_t*	row = rows + (size_t)i * length;
+		uint16_t		map[26];
+		memset(map, 0, sizeof(map));
+		for (uint32_t j = 0; j < length; ++j) {
+			if (((cw[j] | row[j]) & LC_PUNCT) == 0) {
+				map[cw[j]] = (uint16_t)('a' + row[j]);
+			}
+		}
+		mk_filter(other, ocw, map, table->bits + (size_t)i * table->words);
+	}
+	return 0;
+}
+
+
+/*
+ * This function frees up the table, and clears out the struct so that it's
+ * safe to free it again.
+ */
+void mk_pair_free(MKPairTable* table)
+{
+	if (table != NULL) {
+		free(table->bits);
+		memset(table, 0, sizeof(MKPairTable));
+	}
+}
+
+
+/*
+ * This function is mk_narrow() for the other piece of the table when the
+ * first piece has its 'row'th possible - it ANDs that row into 'mask' and
+ * returns the count of the set bits left.
+ */
+uint32_t mk_pair_narrow(const MKPairTable* table, uint32_t row, uint64_t* mask)
+{
+	const uint64_t*	bits = table->bits + (size_t)row * table->words;
+	uint32_t		total = 0;
+	for (uint32_t b = 0; b < table->words; ++b) {
+		mask[b] &= bits[b];
+		total += (uint32_t)__builtin_popcountll(mask[b]);
+	}
+	return total;
+}
+
+
+/*
+ * This function returns the name of the version of the filter in use -
+ * "avx2", "sse2" or "scalar" - for logging.
+ */
+const char* mk_filter_name(void)
+{
+	pickFilter();
+	return __filterName;
+}
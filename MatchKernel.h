@@ -0,0 +1,173 @@
+//
+//  MatchKernel.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/12/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+#ifndef __MATCHKERNEL_H
+#define __MATCHKERNEL_H
+
+// System Headers
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * This is the batch filter for the possibles of a puzzle piece. Rather than
+ * checking the possibles one at a time against the legend, they are stored
+ * by column - all the first letter codes, then all the second, etc. - so
+ * that one legend can be checked against a whole block of them with a few
+ * SIMD compares for each letter the legend knows about. What comes back is
+ * a bit mask of the possibles that are still consistent with the legend -
+ * exactly the ones lc_can_match() would say could match.
+ *
+ * Along with the columns, there's an inverted index of them: for each
+ * column, and each letter, the bit mask of the possibles that have that
+ * letter there - and one more of the ones that have any letter there. Then
+ * the possibles that fit the letters the legend knows about are just the
+ * AND of a few of those masks, a word of 64 possibles at a time, and there's
+ * no comparing of codes at all. Only the punctuation is still compared.
+ *
+ * Each possible also has the set of the plaintext letters it uses, as a
+ * 26-bit mask, so that the ones that need a letter the legend has already
+ * given to a cypher letter that's not in the cypherword - and so can't be
+ * incorporated - are dropped with one AND, and never get to the legend.
+ *
+ * There are SSE2 and AVX2 versions of that compare on x86, and a plain C
+ * one for everything else. The best one the CPU supports is picked the
+ * first time it's needed - and it's what's used for everything if there's
+ * no room for the masks.
+ */
+
+// Public Constants
+#define MK_BLOCK			64
+#define MK_ANY_LETTER		0xff
+#define MK_NO_LEVEL			0xff
+#define MK_UNEXPLAINED		(~0ULL)
+
+// Public Data Types
+typedef struct {
+	uint32_t	count;		// the number of possibles
+	uint32_t	length;		// the number of letter codes in each
+	uint32_t	stride;		// count, rounded up to a whole MK_BLOCK
+	uint8_t*	columns;	// length columns of stride codes each
+	uint8_t*	mixed;		// for each column, 1 if it's not all letters
+	uint64_t*	bits;		// for each column, the masks of each letter, or NULL
+	uint32_t*	letters;	// for each possible, the letters it uses, or NULL
+} MKColumns;
+
+/*
+ * This is the table of which possibles of one piece can go with which of
+ * another piece that shares some of its cypher letters. For each possible
+ * of the first piece, there's a row - a mask, like the one mk_filter()
+ * fills in - of the possibles of the second piece that agree with it on
+ * the letters they share, and don't use any plaintext letter it has given
+ * to another cypher letter. So once the first piece has its word, the
+ * possibles of the second are narrowed by it with one AND of that row.
+ */
+typedef struct {
+	uint32_t	rows;		// the number of possibles of the first piece
+	uint32_t	words;		// the mask words in each row - for the second
+	uint64_t*	bits;		// rows rows of words words each
+} MKPairTable;
+
+/*
+ * This function builds the columns from 'count' possibles of 'length'
+ * letter codes each, stored back to back in 'rows' - as they are in a
+ * PuzzlePiece - along with the masks of each letter in each column, and
+ * the set of the letters in each possible. The padding at the end of each
+ * column is LC_NONE so it never matches. Returns 0, or an errno value if
+ * the columns can't be allocated. If it's only the masks, or the sets,
+ * that can't be, they are left out - the filter compares codes, and the
+ * legend catches the letters that are already taken.
+ */
+int mk_build(MKColumns* cols, const uint8_t* rows, uint32_t count, uint32_t length);
+
+/*
+ * This function frees up the columns, and clears out the struct so that
+ * it's safe to free it again.
+ */
+void mk_free(MKColumns* cols);
+
+/*
+ * This function returns the number of uint64_t words in the bit mask for
+ * 'count' possibles.
+ */
+static inline size_t mk_mask_words(uint32_t count)
+{
+	return (count + MK_BLOCK - 1) / MK_BLOCK;
+}
+
+/*
+ * This function sets bit i of 'mask' if possible i could be the decoding
+ * of the coded cypherword 'cw' under the legend's 'map' - the 26 element
+ * map where '\0' is unmapped - and clears it if not. It's also cleared if
+ * the possible needs a plaintext letter that the map has for a cypher
+ * letter that's not in the cypherword. 'mask' needs to have mk_mask_words()
+ * words. The count of the set bits is returned.
+ */
+uint32_t mk_filter(const MKColumns* cols, const uint8_t* cw, const uint16_t* map, uint64_t* mask);
+
+/*
+ * This function is mk_filter() for a 'mask' that's already been filtered
+ * with a legend that 'map' only adds to - it clears the bits of the ones
+ * that can't match any longer, and only looks at the blocks that have some
+ * bits still set, so it gets cheaper as the possibles are whittled down.
+ * The count of the set bits left is returned.
+ */
+uint32_t mk_narrow(const MKColumns* cols, const uint8_t* cw, const uint16_t* map, uint64_t* mask);
+
+/*
+ * This function explains why the possibles that aren't in 'live' - as
+ * mk_filter() left it for the coded cypherword 'cw' under the 'map' - were
+ * ruled out. 'levels' says, for each mapped cypher letter, the level of the
+ * search that mapped it - or MK_NO_LEVEL if it's part of the hint, and so
+ * can't be undone. What comes back is the set of the levels whose letters
+ * ruled them out, as a mask, with bit n for level n. Each possible is put
+ * down to the earliest level that rules it out, with the hint before them
+ * all, so the set is as shallow as it can be. The ones that can't match no
+ * matter what the legend says are no level's fault. If there are no masks
+ * of the letters in the columns, or if some possible can't be explained,
+ * this returns MK_UNEXPLAINED - every level is to blame.
+ */
+uint64_t mk_explain(const MKColumns* cols, const uint8_t* cw, const uint16_t* map, const uint8_t* levels, const uint64_t* live);
+
+/*
+ * This function builds the table of the 'count' possibles of the first
+ * piece - 'length' letter codes each, back to back in 'rows' - for the
+ * coded cypherword 'cw', against the columns of the possibles of the other
+ * piece, and its coded cypherword 'ocw'. Each row is just the filter of the
+ * other piece with the legend that the one possible would make. Returns 0,
+ * or an errno value if the table can't be allocated.
+ */
+int mk_pair_build(MKPairTable* table, const uint8_t* rows, uint32_t count, uint32_t length, const uint8_t* cw, const MKColumns* other, const uint8_t* ocw);
+
+/*
+ * This function frees up the table, and clears out the struct so that it's
+ * safe to free it again.
+ */
+void mk_pair_free(MKPairTable* table);
+
+/*
+ * This function is mk_narrow() for the other piece of the table when the
+ * first piece has its 'row'th possible - it ANDs that row into 'mask' and
+ * returns the count of the set bits left.
+ */
+uint32_t mk_pair_narrow(const MKPairTable* table, uint32_t row, uint64_t* mask);
+
+/*
+ * This function returns the name of the version of the filter in use -
+ * "avx2", "sse2" or "scalar" - for logging.
+ */
+const char* mk_filter_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// __MATCHKERNEL_H
@@ -21,6 +21,8 @@
 // Superclass Headers
 
 // Forward Class Declarations
+@class PatternIndex;
+@class Quip;
 
 // Public Data Types
 
@@ -43,7 +45,16 @@
 	IBOutlet NSPopUpButton*	_plainChar;
 	IBOutlet NSTextField*	_plaintextLine;
 	IBOutlet NSTextField*	_statusLine;
-	NSMutableArray*			_wordList;
+	IBOutlet NSButton*		_solveButton;
+	PatternIndex*			_patternIndex;
+	Quip*					_quip;
+	NSTimer*				_progressTimer;
+	NSTimeInterval			_solveStart;
+	NSTimeInterval			_lastProgress;
+	uint64_t				_lastNodeCount;
+	NSUInteger				_solutionCount;
+	BOOL					_cancelled;
+	BOOL					_overBudget;
 }
 
 //----------------------------------------------------------------------------
@@ -96,18 +107,50 @@
 - (NSTextField*) getStatusLine;
 
 /*!
- This method sets the list of acceptable, known, words that the engine has at
- it's disposal. If the word isn't in this list, it's impossible to decode any
- cyphertext into it. Try to make this as complete as possible.
+ This method returns the button that starts the solving - and while it's
+ solving, stops it, as it's then the 'Cancel' button.
  */
-- (void) setWordList:(NSMutableArray*)list;
+- (NSButton*) getSolveButton;
 
 /*!
- This method returns the list of all the words we know about. This is important
- source material for any and all solution attacks as they have to have some
- idea of the possible words to map to.
+ This method sets the index of all the known words, organized by their
+ pattern. It's the list of acceptable, known, words that the engine has at
+ it's disposal. If the word isn't in this index, it's impossible to decode
+ any cyphertext into it. Every Quip we solve uses it to find the possible
+ plaintexts for its cypherwords.
  */
-- (NSMutableArray*) getWordList;
+- (void) setPatternIndex:(PatternIndex*)index;
+
+/*!
+ This method returns the index of all the known words, organized by their
+ pattern, so that building a Quip doesn't have to scan every word.
+ */
+- (PatternIndex*) getPatternIndex;
+
+/*!
+ This method sets the Quip that's being solved in the background, or nil
+ when nothing is being solved. It's only ever touched on the main thread,
+ so it's how we know if there's a solve going on.
+ */
+- (void) setQuip:(Quip*)quip;
+
+/*!
+ This method returns the Quip that's being solved in the background, or
+ nil if there's nothing being solved right now.
+ */
+- (Quip*) getQuip;
+
+/*!
+ This method sets the timer that updates the status line with the progress
+ of the solve that's running, or nil when there's nothing running.
+ */
+- (void) setProgressTimer:(NSTimer*)timer;
+
+/*!
+ This method returns the timer that updates the status line with the
+ progress of the solve that's running, or nil.
+ */
+- (NSTimer*) getProgressTimer;
 
 //----------------------------------------------------------------------------
 //					IB Actions
@@ -118,9 +161,17 @@
  they want us to solve the provided puzzle. It's going to create a Quip with
  the cyphertext and the initial start at a legend and then ask it to solve the
  puzzle. When it's done, we'll pick off the solutions and see what we see.
+ If there's already a solve running, this stops it instead - the button is
+ the 'Cancel' button while it's solving.
  */
 - (IBAction) decode:(id)sender;
 
+/*!
+ This action stops the solve that's running in the background, if there is
+ one. What's been found so far stays in the window.
+ */
+- (IBAction) cancel:(id)sender;
+
 /*!
  This method runs a simple test decoding so that we can be sure that things
  are working properly. It's going to use the cyphertext:
@@ -136,8 +187,11 @@
 /*!
  This method is what really runs the decoder, and it takes the cyphertext
  string as well as the initial part of the legend, and will load up the
- Quip and have it do it's thing, placing the solution in the text field
- when it's done. Pretty simple. I just needed a single method to do this.
+ Quip and have it do it's thing on a background thread, so the window
+ stays live. The first solution is placed in the text field as soon as
+ it's found, while the search keeps going, and the status line shows how
+ it's going until it's done, it's cancelled, or it runs out of its time
+ budget. If there's already a solve running, this does nothing.
 
  @param cyphertext The source cyphertext to decode
  @param cypher The cypher character that's part of the hint
@@ -145,6 +199,45 @@
  */
 - (void) solve:(NSString*)cyphertext where:(unichar)cypher equals:(unichar)plain;
 
+//----------------------------------------------------------------------------
+//					Background Solving Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method is the body of the background thread for a solve. It runs
+ the attack on the Quip, passing each solution back to the main thread as
+ it's found, and then lets the main thread know it's done.
+
+ @param quip The Quip to solve
+ */
+- (void) runSolve:(Quip*)quip;
+
+/*!
+ This method is called on the main thread with each solution as it's found.
+ The first one goes in the plaintext line, and they are all counted.
+
+ @param plaintext The plaintext of the solution
+ */
+- (void) showSolution:(NSString*)plaintext;
+
+/*!
+ This method is called by the progress timer, on the main thread, to put
+ the depth of the search, the nodes per second, and the solutions so far
+ on the status line - and to stop the search if it's used up its budget.
+
+ @param timer The progress timer that fired
+ */
+- (void) updateProgress:(NSTimer*)timer;
+
+/*!
+ This method is called on the main thread when the background solve is
+ done - however it got that way - to say how it went, and get everything
+ ready for the next one.
+
+ @param quip The Quip that was being solved
+ */
+- (void) solveDone:(Quip*)quip;
+
 //----------------------------------------------------------------------------
 //					General Housekeeping
 //----------------------------------------------------------------------------
@@ -9,6 +9,7 @@
 // Apple Headers
 
 // System Headers
+#include <ctype.h>
 
 // Third Party Headers
 
@@ -17,6 +18,7 @@
 // Class Headers
 #import "MrBig.h"
 #import "Quip.h"
+#import "PatternIndex.h"
 
 // Superclass Headers
 
@@ -25,6 +27,11 @@
 // Private Data Types
 
 // Private Constants
+#define TIME_BUDGET_KEY			@"SolveTimeBudget"
+#define SOLUTION_LIMIT_KEY		@"SolveSolutionLimit"
+#define DEFAULT_TIME_BUDGET		30.0
+#define DEFAULT_SOLUTION_LIMIT	0
+#define PROGRESS_INTERVAL		0.25
 
 // Private Macros
 
@@ -58,8 +65,17 @@
 	 * subclasses.
 	 */
 	if (self == [MrBig class]) {
-        /* put initialization code here */
-    }
+		/*
+		 * A solve runs until it's found this many solutions - zero for
+		 * all of them - or for this many seconds - zero for as long as
+		 * it takes - whichever comes first.
+		 */
+		NSDictionary*	defs = [NSDictionary dictionaryWithObjectsAndKeys:
+									[NSNumber numberWithDouble:DEFAULT_TIME_BUDGET], TIME_BUDGET_KEY,
+									[NSNumber numberWithUnsignedInteger:DEFAULT_SOLUTION_LIMIT], SOLUTION_LIMIT_KEY,
+									nil];
+		[[NSUserDefaults standardUserDefaults] registerDefaults:defs];
+	}
 }
 
 
@@ -120,24 +136,79 @@
 
 
 /*!
- This method sets the list of acceptable, known, words that the engine has at
- it's disposal. If the word isn't in this list, it's impossible to decode any
- cyphertext into it. Try to make this as complete as possible.
+ This method returns the button that starts the solving - and while it's
+ solving, stops it, as it's then the 'Cancel' button.
  */
-- (void) setWordList:(NSMutableArray*)list
+- (NSButton*) getSolveButton
 {
-	_wordList = list;
+	return _solveButton;
 }
 
 
 /*!
- This method returns the list of all the words we know about. This is important
- source material for any and all solution attacks as they have to have some
- idea of the possible words to map to.
+ This method sets the index of all the known words, organized by their
+ pattern. It's the list of acceptable, known, words that the engine has at
+ it's disposal. If the word isn't in this index, it's impossible to decode
+ any cyphertext into it. Every Quip we solve uses it to find the possible
+ plaintexts for its cypherwords.
  */
-- (NSMutableArray*) getWordList
+- (void) setPatternIndex:(PatternIndex*)index
 {
-	return _wordList;
+	_patternIndex = index;
+}
+
+
+/*!
+ This method returns the index of all the known words, organized by their
+ pattern, so that building a Quip doesn't have to scan every word.
+ */
+- (PatternIndex*) getPatternIndex
+{
+	return _patternIndex;
+}
+
+
+/*!
+ This method sets the Quip that's being solved in the background, or nil
+ when nothing is being solved. It's only ever touched on the main thread,
+ so it's how we know if there's a solve going on.
+ */
+- (void) setQuip:(Quip*)quip
+{
+	_quip = quip;
+}
+
+
+/*!
+ This method returns the Quip that's being solved in the background, or
+ nil if there's nothing being solved right now.
+ */
+- (Quip*) getQuip
+{
+	return _quip;
+}
+
+
+/*!
+ This method sets the timer that updates the status line with the progress
+ of the solve that's running, or nil when there's nothing running.
+ */
+- (void) setProgressTimer:(NSTimer*)timer
+{
+	if (_progressTimer != timer) {
+		[_progressTimer invalidate];
+		_progressTimer = timer;
+	}
+}
+
+
+/*!
+ This method returns the timer that updates the status line with the
+ progress of the solve that's running, or nil.
+ */
+- (NSTimer*) getProgressTimer
+{
+	return _progressTimer;
 }
 
 
@@ -150,9 +221,17 @@
  they want us to solve the provided puzzle. It's going to create a Quip with
  the cyphertext and the initial start at a legend and then ask it to solve the
  puzzle. When it's done, we'll pick off the solutions and see what we see.
+ If there's already a solve running, this stops it instead - the button is
+ the 'Cancel' button while it's solving.
  */
 - (IBAction) decode:(id)sender
 {
+	// if we're already solving, then this is the 'Cancel' button
+	if ([self getQuip] != nil) {
+		[self cancel:sender];
+		return;
+	}
+
 	// get the values from the UI elements
 	NSString*	cyphertext = [[self getCyphertextLine] stringValue];
 	NSString*	cypher = [[self getCypherChar] titleOfSelectedItem];
@@ -174,6 +253,20 @@
 }
 
 
+/*!
+ This action stops the solve that's running in the background, if there is
+ one. What's been found so far stays in the window.
+ */
+- (IBAction) cancel:(id)sender
+{
+	if ([self getQuip] != nil) {
+		_cancelled = YES;
+		[self showStatus:@"Cancelling..."];
+		[[self getQuip] cancelAttack];
+	}
+}
+
+
 /*!
  This method runs a simple test decoding so that we can be sure that things
  are working properly. It's going to use the cyphertext:
@@ -193,8 +286,11 @@
 /*!
  This method is what really runs the decoder, and it takes the cyphertext
  string as well as the initial part of the legend, and will load up the
- Quip and have it do it's thing, placing the solution in the text field
- when it's done. Pretty simple. I just needed a single method to do this.
+ Quip and have it do it's thing on a background thread, so the window
+ stays live. The first solution is placed in the text field as soon as
+ it's found, while the search keeps going, and the status line shows how
+ it's going until it's done, it's cancelled, or it runs out of its time
+ budget. If there's already a solve running, this does nothing.
 
  @param cyphertext The source cyphertext to decode
  @param cypher The cypher character that's part of the hint
@@ -202,16 +298,139 @@
  */
 - (void) solve:(NSString*)cyphertext where:(unichar)cypher equals:(unichar)plain
 {
+	// only one at a time - the button is the 'Cancel' button until it's done
+	if ([self getQuip] != nil) {
+		NSLog(@"Already solving a puzzle - ignoring: '%@' where %c=%c", cyphertext, cypher, plain);
+		return;
+	}
+
 	NSLog(@"Solving puzzle: '%@' where %c=%c", cyphertext, cypher, plain);
 	// make a new Quip, and give it the arguments it needs.
-	Quip*	q = [[Quip alloc] initWithCypherText:cyphertext where:cypher equals:plain usingDict:[self getWordList]];
-	if ([q attemptWordBlockAttack]) {
-		NSLog(@"Solution found: '%@'", [[q getSolutions] objectAtIndex:0]);
-		[[self getPlaintextLine] setStringValue:[[q getSolutions] objectAtIndex:0]];
+	Quip*	q = [[Quip alloc] initWithCypherText:cyphertext where:cypher equals:plain usingIndex:[self getPatternIndex]];
+	[self setQuip:q];
+	_solveStart = [NSDate timeIntervalSinceReferenceDate];
+	_lastProgress = _solveStart;
+	_lastNodeCount = 0;
+	_solutionCount = 0;
+	_cancelled = NO;
+	_overBudget = NO;
+
+	// clear out the last answer, and make the button the way to stop this one
+	[[self getPlaintextLine] setStringValue:@""];
+	[[self getSolveButton] setTitle:@"Cancel"];
+	[self showStatus:@"Solving..."];
+
+	// ...and get it going in the background, checking on it every so often
+	[self setProgressTimer:[NSTimer scheduledTimerWithTimeInterval:PROGRESS_INTERVAL target:self selector:@selector(updateProgress:) userInfo:nil repeats:YES]];
+	[NSThread detachNewThreadSelector:@selector(runSolve:) toTarget:self withObject:q];
+}
+
+
+//----------------------------------------------------------------------------
+//					Background Solving Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method is the body of the background thread for a solve. It runs
+ the attack on the Quip, passing each solution back to the main thread as
+ it's found, and then lets the main thread know it's done.
+
+ @param quip The Quip to solve
+ */
+- (void) runSolve:(Quip*)quip
+{
+	@autoreleasepool {
+		// a negative limit is a bad default, and not 'as many as there are'
+		NSInteger	wanted = [[NSUserDefaults standardUserDefaults] integerForKey:SOLUTION_LIMIT_KEY];
+		NSUInteger	limit = (wanted >= 0 ? (NSUInteger)wanted : DEFAULT_SOLUTION_LIMIT);
+		[quip attemptWordBlockAttackWithOptions:QuipAttackSerial limit:limit solutionHandler:^(Legend* legend, NSString* plaintext) {
+			[self performSelectorOnMainThread:@selector(showSolution:) withObject:plaintext waitUntilDone:NO];
+		}];
+		// this is queued after all the solutions, so they'll be shown first
+		[self performSelectorOnMainThread:@selector(solveDone:) withObject:quip waitUntilDone:NO];
 	}
 }
 
 
+/*!
+ This method is called on the main thread with each solution as it's found.
+ The first one goes in the plaintext line, and they are all counted.
+
+ @param plaintext The plaintext of the solution
+ */
+- (void) showSolution:(NSString*)plaintext
+{
+	if (++_solutionCount == 1) {
+		NSLog(@"Solution found: '%@'", plaintext);
+		[[self getPlaintextLine] setStringValue:plaintext];
+	} else {
+		NSLog(@"Another solution found: '%@'", plaintext);
+	}
+}
+
+
+/*!
+ This method is called by the progress timer, on the main thread, to put
+ the depth of the search, the nodes per second, and the solutions so far
+ on the status line - and to stop the search if it's used up its budget.
+
+ @param timer The progress timer that fired
+ */
+- (void) updateProgress:(NSTimer*)timer
+{
+	Quip*	q = [self getQuip];
+	if (q != nil) {
+		NSTimeInterval	now = [NSDate timeIntervalSinceReferenceDate];
+		uint64_t		nodes = [q getNodeCount];
+		double			rate = (now > _lastProgress ? (nodes - _lastNodeCount) / (now - _lastProgress) : 0.0);
+		_lastProgress = now;
+		_lastNodeCount = nodes;
+		[[self getStatusLine] setStringValue:[NSString stringWithFormat:@"Solving... depth %lu, %.0f nodes/sec, %lu solution%@, %.1f sec",
+											  (unsigned long)[q getCurrentDepth], rate, (unsigned long)_solutionCount,
+											  (_solutionCount == 1 ? @"" : @"s"), (now - _solveStart)]];
+
+		// see if it's time to call it a day
+		NSTimeInterval	budget = [[NSUserDefaults standardUserDefaults] doubleForKey:TIME_BUDGET_KEY];
+		if ((budget > 0.0) && (now - _solveStart >= budget) && !_overBudget) {
+			_overBudget = YES;
+			[q cancelAttack];
+		}
+	}
+}
+
+
+/*!
+ This method is called on the main thread when the background solve is
+ done - however it got that way - to say how it went, and get everything
+ ready for the next one.
+
+ @param quip The Quip that was being solved
+ */
+- (void) solveDone:(Quip*)quip
+{
+	NSTimeInterval	elapsed = [NSDate timeIntervalSinceReferenceDate] - _solveStart;
+	[self setProgressTimer:nil];
+	[self setQuip:nil];
+	[[self getSolveButton] setTitle:@"Solve"];
+
+	// say how it went - and why it stopped, if it didn't finish
+	NSString*	how = @"Done";
+	if (_overBudget) {
+		how = [NSString stringWithFormat:@"Out of time (%.0f sec)", [[NSUserDefaults standardUserDefaults] doubleForKey:TIME_BUDGET_KEY]];
+	} else if (_cancelled) {
+		how = @"Cancelled";
+	}
+	NSString*	status = [NSString stringWithFormat:@"%@ - %lu solution%@, %llu nodes, %.3f sec", how,
+						  (unsigned long)_solutionCount, (_solutionCount == 1 ? @"" : @"s"),
+						  (unsigned long long)[quip getNodeCount], elapsed];
+	// if the solver is keeping statistics, show them off along with it
+	if ([quip getStatisticsSummary] != nil) {
+		status = [status stringByAppendingFormat:@" - %@", [quip getStatisticsSummary]];
+	}
+	[self showStatus:status];
+}
+
+
 //----------------------------------------------------------------------------
 //					General Housekeeping
 //----------------------------------------------------------------------------
@@ -247,7 +466,9 @@
  */
 - (void) windowWillClose:(NSNotification*)aNotification
 {
-	
+	// there's no one to show the answer to any more
+	[self setProgressTimer:nil];
+	[[self getQuip] cancelAttack];
 }
 
 
@@ -293,18 +514,23 @@
 - (id) init
 {
 	if (self = [super init]) {
-		NSMutableArray*		a = [[NSMutableArray alloc] init];
-		if (a == nil) {
-			NSLog(@"[MrBig -init] - the storage for all the plaintext words could not be created. This is a serious allocation error and needs to be looked into as soon as possible.");
+		/*
+		 * The words are compiled into an image that we can simply mmap,
+		 * and it's kept in the user's caches, so it'll only get rebuilt
+		 * when the 'words' file in the bundle changes.
+		 */
+		NSString*	resDir = [[NSBundle mainBundle] resourcePath];
+		NSString*	wordsFile = [NSString stringWithFormat:@"%@/words", resDir];
+		NSArray*	caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+		NSString*	cacheDir = ([caches count] > 0 ? [caches objectAtIndex:0] : NSTemporaryDirectory());
+		NSString*	dictFile = [cacheDir stringByAppendingPathComponent:@"CryptoQuip/words.qdict"];
+		PatternIndex*	idx = [PatternIndex createPatternIndexForWordsFile:wordsFile compiledTo:dictFile];
+		if (idx == nil) {
+			NSLog(@"[MrBig -init] - the index of all the plaintext words could not be created from %@. This is a serious error and needs to be looked into as soon as possible.", wordsFile);
 		} else {
-			// get the location of the 'words' file
-			NSString*	resDir = [[NSBundle mainBundle] resourcePath];
-			NSString*	wordsFile = [NSString stringWithFormat:@"%@/words", resDir];
-			NSString*	contents = [NSString stringWithContentsOfFile:wordsFile encoding:NSUTF8StringEncoding error:NULL];
-			[a addObjectsFromArray:[contents componentsSeparatedByString:@"\n"]];
-			NSLog(@"Loaded %lu words from %@", [a count], wordsFile);
+			NSLog(@"Loaded %@ from %@", idx, wordsFile);
 			// now save what we have
-			[self setWordList:a];
+			[self setPatternIndex:idx];
 		}
 	}
 	return self;	
@@ -318,10 +544,11 @@
  */
 - (void) dealloc
 {
-	// drop all the memory we're using
-	[[self getWordList] removeAllObjects];
-	// ...and the array that held it
-	[self setWordList:nil];
+	// stop anything that's still going
+	[self setProgressTimer:nil];
+	[[self getQuip] cancelAttack];
+	// drop the index of all the words - and the image it's holding
+	[self setPatternIndex:nil];
 }
 
 @end
@@ -0,0 +1,162 @@
+//
+//  NogoodTable.c
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/18/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// System Headers
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Other Headers
+#include "NogoodTable.h"
+
+// Private Constants
+#define DEPTH_BITS		0xffULL
+
+
+/*
+ * This function is the finalizer of splitmix64 - it mixes up all 64 bits
+ * of the value so that every bit of the input has a say in every bit of
+ * the output.
+ */
+static inline uint64_t mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+
+/*
+ * This function makes the entry for the place - the hash in the high bits,
+ * and the depth in the low byte - so that it's never zero, which is an
+ * empty entry.
+ */
+static inline uint64_t makeEntry(uint64_t key, uint32_t depth)
+{
+	uint64_t	hash = key & ~DEPTH_BITS;
+	if (hash == 0) {
+		hash = DEPTH_BITS + 1;
+	}
+	return hash | (depth < DEPTH_BITS ? depth : DEPTH_BITS);
+}
+
+
+/*
+ * This function makes the table with room for at least 'count' places.
+ * Returns 0, or an errno value if the table can't be allocated.
+ */
+int ng_init(NGTable* table, size_t count)
+{
+	memset(table, 0, sizeof(NGTable));
+	size_t		buckets = 1;
+	while (buckets * NG_WAYS < count) {
+		buckets <<= 1;
+	}
+	table->entries = calloc(buckets * NG_WAYS, sizeof(uint64_t));
+	if (table->entries == NULL) {
+		return ENOMEM;
+	}
+	table->buckets = buckets;
+	return 0;
+}
+
+
+/*
+ * This function empties out the table, so it can be used for another
+ * search.
+ */
+void ng_clear(NGTable* table)
+{
+	if (table->entries != NULL) {
+		memset(table->entries, 0, table->buckets * NG_WAYS * sizeof(uint64_t));
+	}
+}
+
+
+/*
+ * This function frees up the table, and clears out the struct so that it's
+ * safe to free it again.
+ */
+void ng_free(NGTable* table)
+{
+	if (table != NULL) {
+		free(table->entries);
+		memset(table, 0, sizeof(NGTable));
+	}
+}
+
+
+/*
+ * This function returns the hash of the place in the search 'depth' deep,
+ * with the pieces in 'group' still to get words. For each of the cypher
+ * letters in 'letters', the plaintext letter in the legend's 'map' - where
+ * '\0' is unmapped - goes into it, along with 'taken', the set of the
+ * plaintext letters in the legend.
+ */
+uint64_t ng_hash(uint64_t group, uint32_t depth, uint32_t letters, const uint16_t* map, uint32_t taken)
+{
+	uint64_t	hash = mix(group ^ ((uint64_t)depth << 32 | taken));
+	for (uint32_t bits = letters; bits != 0; bits &= (bits - 1)) {
+		uint32_t	c = (uint32_t)__builtin_ctz(bits);
+		hash = mix(hash ^ ((uint64_t)c << 8 | map[c]));
+	}
+	return hash;
+}
+
+
+/*
+ * This function returns 1 if the place with the hash 'key', 'depth' deep,
+ * is in the table as having no solutions below it.
+ */
+int ng_lookup(const NGTable* table, uint64_t key, uint32_t depth)
+{
+	int			found = 0;
+	if (table->entries != NULL) {
+		uint64_t		entry = makeEntry(key, depth);
+		const uint64_t*	bucket = table->entries + ((key >> 8) & (table->buckets - 1)) * NG_WAYS;
+		for (int i = 0; !found && (i < NG_WAYS); ++i) {
+			found = (__atomic_load_n(&bucket[i], __ATOMIC_RELAXED) == entry);
+		}
+	}
+	return found;
+}
+
+
+/*
+ * This function puts the place with the hash 'key', 'depth' deep, into the
+ * table as having no solutions below it.
+ */
+void ng_store(NGTable* table, uint64_t key, uint32_t depth)
+{
+	if (table->entries != NULL) {
+		uint64_t		entry = makeEntry(key, depth);
+		uint64_t*		bucket = table->entries + ((key >> 8) & (table->buckets - 1)) * NG_WAYS;
+		/*
+		 * Take an empty entry if there is one - or this one, if it's already
+		 * there - and if not, the one for the deepest place, as it's the one
+		 * with the least search below it.
+		 */
+		int			victim = 0;
+		uint64_t	deepest = 0;
+		for (int i = 0; i < NG_WAYS; ++i) {
+			uint64_t	old = __atomic_load_n(&bucket[i], __ATOMIC_RELAXED);
+			if ((old == 0) || (old == entry)) {
+				victim = i;
+				break;
+			}
+			if ((old & DEPTH_BITS) > deepest) {
+				deepest = old & DEPTH_BITS;
+				victim = i;
+			}
+		}
+		__atomic_store_n(&bucket[victim], entry, __ATOMIC_RELAXED);
+	}
+}
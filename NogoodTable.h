@@ -0,0 +1,93 @@
+//
+//  NogoodTable.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/18/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+#ifndef __NOGOODTABLE_H
+#define __NOGOODTABLE_H
+
+// System Headers
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * This is the table of the places in the search that are known to have no
+ * solutions below them - the 'nogoods'. The search often gets to the same
+ * place by different paths - two short words swapped, say - and without
+ * this, it would look all through the same dead end every time.
+ *
+ * A place is the pieces that are still left to get words, and what the
+ * legend says about them: the plaintext letters of their cypher letters,
+ * and the plaintext letters that are taken. Nothing else in the legend can
+ * make any difference to what's below. That's hashed down to 64 bits, and
+ * only the hash is kept, so the table is small, and a lookup is a couple
+ * of loads - the chance of two places having the same hash is far too
+ * small to worry about.
+ *
+ * The table is a fixed number of buckets of NG_WAYS entries each, and when
+ * a bucket is full, the entry for the deepest place is the one that goes,
+ * as it saved the least work. The entries are read and written atomically,
+ * so many threads can share one table with no locks - they might lose an
+ * entry to one another now and then, but that only costs a little search.
+ */
+
+// Public Constants
+#define NG_WAYS				4
+
+// Public Data Types
+typedef struct {
+	uint64_t*	entries;	// the hash of each place, with its depth
+	size_t		buckets;	// the number of buckets - a power of two
+} NGTable;
+
+/*
+ * This function makes the table with room for at least 'count' places.
+ * Returns 0, or an errno value if the table can't be allocated.
+ */
+int ng_init(NGTable* table, size_t count);
+
+/*
+ * This function empties out the table, so it can be used for another
+ * search.
+ */
+void ng_clear(NGTable* table);
+
+/*
+ * This function frees up the table, and clears out the struct so that it's
+ * safe to free it again.
+ */
+void ng_free(NGTable* table);
+
+/*
+ * This function returns the hash of the place in the search 'depth' deep,
+ * with the pieces in 'group' still to get words. For each of the cypher
+ * letters in 'letters', the plaintext letter in the legend's 'map' - where
+ * '\0' is unmapped - goes into it, along with 'taken', the set of the
+ * plaintext letters in the legend.
+ */
+uint64_t ng_hash(uint64_t group, uint32_t depth, uint32_t letters, const uint16_t* map, uint32_t taken);
+
+/*
+ * This function returns 1 if the place with the hash 'key', 'depth' deep,
+ * is in the table as having no solutions below it.
+ */
+int ng_lookup(const NGTable* table, uint64_t key, uint32_t depth);
+
+/*
+ * This function puts the place with the hash 'key', 'depth' deep, into the
+ * table as having no solutions below it.
+ */
+void ng_store(NGTable* table, uint64_t key, uint32_t depth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// __NOGOODTABLE_H
@@ -0,0 +1,221 @@
+//
+//  PatternIndex.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 5/30/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+#import <Foundation/Foundation.h>
+
+// System Headers
+
+// Third Party Headers
+
+// Other Headers
+#include "QuipDict.h"
+
+// Class Headers
+#import "CypherWord.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Public Data Types
+
+// Public Constants
+
+// Public Macros
+
+
+/*!
+ @class PatternIndex
+ This class is the dictionary of known plaintext words, but organized by
+ the pattern of each word. Since a cypherword can only ever decode to a
+ word with the same pattern, building this once means that finding all
+ the possible plaintexts for a cypherword is a single lookup, and not a
+ scan of every word we know about.
+
+ The words themselves live in a compiled QuipDict image - either built in
+ memory from a list of words, or mmap'd from a file that was compiled by
+ the 'mkquipdict' tool, or by us, the first time we saw the word list.
+ */
+@interface PatternIndex : NSObject {
+@private
+	QDImage					_image;
+	NSMutableDictionary*	_patterns;
+}
+
+//----------------------------------------------------------------------------
+//					Creation Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method allows the caller to create an autoreleased PatternIndex that
+ is built from the provided list of plaintext words. This is typically
+ done once, when the words are loaded, and then used for every Quip.
+
+ @param words The array of plaintext words to index
+ @return newly created PatternIndex
+ */
++ (PatternIndex*) createPatternIndex:(NSArray*)words;
+
+/*!
+ This method allows the caller to create an autoreleased PatternIndex that
+ is the compiled image at the provided path mmap'd into memory. This is
+ very fast, and the pages are shared with every other process using the
+ same image. If the file isn't a valid image, this returns nil.
+
+ @param path The path to the compiled QuipDict image
+ @return newly created PatternIndex
+ */
++ (PatternIndex*) createPatternIndexFromFile:(NSString*)path;
+
+/*!
+ This method is the way to load the word list 'wordsPath' if you can. It
+ looks at the compiled image at 'dictPath', and if it's missing, or out
+ of date with respect to the word list, it rebuilds it. Then it mmaps the
+ image. If the image can't be written, the words are indexed in memory so
+ that the caller always gets an index, if the word list is readable.
+
+ @param wordsPath The path to the list of plaintext words
+ @param dictPath The path to the compiled image of those words
+ @return newly created PatternIndex
+ */
++ (PatternIndex*) createPatternIndexForWordsFile:(NSString*)wordsPath compiledTo:(NSString*)dictPath;
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the number of distinct words that have been indexed.
+ Duplicates in the source list are only counted - and indexed - once.
+
+ @param
+ @return Count of unique words in the index
+ */
+- (NSUInteger) getWordCount;
+
+/*!
+ This method returns the number of distinct patterns in the index. It's
+ really only interesting for logging and tuning, but it's nice to know.
+
+ @param
+ @return Count of unique patterns in the index
+ */
+- (NSUInteger) getPatternCount;
+
+//----------------------------------------------------------------------------
+//					Initialization Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method initializes the index with the provided array of plaintext
+ words. Each is placed in the list for its pattern, and empty strings as
+ well as duplicates are quietly skipped. The image is built in memory.
+
+ @param words The array of plaintext words to index
+ @return self
+ */
+- (id) initWithWords:(NSArray*)words;
+
+/*!
+ This method initializes the index by mmap'ing the compiled image at the
+ provided path. Only the header is checked, so this is constant time. If
+ the file isn't a valid image, this returns nil.
+
+ @param path The path to the compiled QuipDict image
+ @return self
+ */
+- (id) initWithContentsOfFile:(NSString*)path;
+
+//----------------------------------------------------------------------------
+//					Lookup Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the array of all the indexed words that have the
+ provided pattern - as created by +[CypherWord createPatternText:]. If
+ there are no such words, an empty array is returned - never nil.
+
+ @param pattern The uniform pattern of the words to return
+ @return The array of all words having that pattern
+ */
+- (NSArray*) getWordsForPattern:(NSString*)pattern;
+
+/*!
+ This method returns the array of all the indexed words that pattern
+ match the provided CypherWord. These are all the possible plaintexts
+ for that cypherword, and is exactly what a PuzzlePiece needs.
+
+ @param cw The CypherWord to find the possible plaintexts for
+ @return The array of all words having the pattern of the cypherword
+ */
+- (NSArray*) getWordsMatchingCypherWord:(CypherWord*)cw;
+
+/*!
+ This method returns the ids of all the indexed words that have the
+ provided pattern. The words of a pattern are all together in the index,
+ so it's just the range of them - and it's empty if there are no such
+ words. Nothing is allocated, and it can be called from many threads.
+
+ @param pattern The uniform pattern of the words to find
+ @return The range of the ids of all words having that pattern
+ */
+- (NSRange) getWordIdsForPattern:(NSString*)pattern;
+
+/*!
+ This method returns the ids of all the indexed words that pattern match
+ the provided CypherWord - the ids of the possible plaintexts for it.
+
+ @param cw The CypherWord to find the possible plaintexts for
+ @return The range of the ids of all words having the pattern of the cypherword
+ */
+- (NSRange) getWordIdsMatchingCypherWord:(CypherWord*)cw;
+
+/*!
+ This method returns the lowercase, NUL-terminated, text of the word with
+ the provided id - right out of the index, so it's only good for as long as
+ the index is around, and it's not to be changed.
+
+ @param wid The id of the word
+ @return The text of the word
+ */
+- (const char*) getWordText:(uint32_t)wid;
+
+/*!
+ This method returns the word with the provided id as an NSString. It's
+ made on every call, so it's for when the word is really needed - like a
+ solution being reported - and not for the search.
+
+ @param wid The id of the word
+ @return The word as a new NSString
+ */
+- (NSString*) getWord:(uint32_t)wid;
+
+//----------------------------------------------------------------------------
+//					NSObject Overridden Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method makes sure to call the super's -init and then allocation all the
+ things we're going to need to function properly.
+ */
+- (id) init;
+
+/*!
+ Because we have the image mapped, or allocated, we need to make sure that
+ we clean up after ourselves, and that's what we're going to be doing here.
+ */
+- (void) dealloc;
+
+/*!
+ This method returns a string that describes the contents of this guy in a
+ nice, human-readable format so that it's suitable for logging and debuggung.
+ */
+- (NSString*) description;
+
+@end
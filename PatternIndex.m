@@ -0,0 +1,390 @@
+//
+//  PatternIndex.m
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 5/30/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+
+// System Headers
+#include <stdlib.h>
+#include <string.h>
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "PatternIndex_Protected.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Private Data Types
+
+// Private Constants
+
+// Private Macros
+
+
+/*!
+ @class PatternIndex
+ This class is the dictionary of known plaintext words, but organized by
+ the pattern of each word. Since a cypherword can only ever decode to a
+ word with the same pattern, building this once means that finding all
+ the possible plaintexts for a cypherword is a single lookup, and not a
+ scan of every word we know about.
+
+ The words themselves live in a compiled QuipDict image - either built in
+ memory from a list of words, or mmap'd from a file that was compiled by
+ the 'mkquipdict' tool, or by us, the first time we saw the word list.
+ */
+@implementation PatternIndex
+
+//----------------------------------------------------------------------------
+//					Creation Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method allows the caller to create an autoreleased PatternIndex that
+ is built from the provided list of plaintext words. This is typically
+ done once, when the words are loaded, and then used for every Quip.
+
+ @param words The array of plaintext words to index
+ @return newly created PatternIndex
+ */
++ (PatternIndex*) createPatternIndex:(NSArray*)words
+{
+	// create what we said we would - this is just a convenience method
+	return [[PatternIndex alloc] initWithWords:words];
+}
+
+
+/*!
+ This method allows the caller to create an autoreleased PatternIndex that
+ is the compiled image at the provided path mmap'd into memory. This is
+ very fast, and the pages are shared with every other process using the
+ same image. If the file isn't a valid image, this returns nil.
+
+ @param path The path to the compiled QuipDict image
+ @return newly created PatternIndex
+ */
++ (PatternIndex*) createPatternIndexFromFile:(NSString*)path
+{
+	// create what we said we would - this is just a convenience method
+	return [[PatternIndex alloc] initWithContentsOfFile:path];
+}
+
+
+/*!
+ This method is the way to load the word list 'wordsPath' if you can. It
+ looks at the compiled image at 'dictPath', and if it's missing, or out
+ of date with respect to the word list, it rebuilds it. Then it mmaps the
+ image. If the image can't be written, the words are indexed in memory so
+ that the caller always gets an index, if the word list is readable.
+
+ @param wordsPath The path to the list of plaintext words
+ @param dictPath The path to the compiled image of those words
+ @return newly created PatternIndex
+ */
++ (PatternIndex*) createPatternIndexForWordsFile:(NSString*)wordsPath compiledTo:(NSString*)dictPath
+{
+	PatternIndex*	index = nil;
+	BOOL			error = NO;
+
+	// see if there's anything to do
+	if (!error) {
+		if ((wordsPath == nil) || (dictPath == nil)) {
+			error = YES;
+			NSLog(@"[PatternIndex +createPatternIndexForWordsFile:compiledTo:] - the path to the words, or the compiled image, is nil and that really means that there's nothing for me to do. Please make sure the arguments to this method are not nil before calling.");
+		}
+	}
+
+	// if the compiled image is stale, or missing, then (re)build it
+	if (!error) {
+		const char*	src = [wordsPath fileSystemRepresentation];
+		const char*	dst = [dictPath fileSystemRepresentation];
+		if (!qd_is_current(dst, src)) {
+			[[NSFileManager defaultManager] createDirectoryAtPath:[dictPath stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:NULL];
+			int		err = qd_build_file(src, dst);
+			if (err != 0) {
+				NSLog(@"[PatternIndex +createPatternIndexForWordsFile:compiledTo:] - the compiled image %@ could not be built from %@: %s. We'll index the words in memory, but that's slower, and needs to be looked into.", dictPath, wordsPath, strerror(err));
+			} else {
+				NSLog(@"Compiled %@ into %@", wordsPath, dictPath);
+			}
+		}
+		// ...now map it in, if we can
+		index = [PatternIndex createPatternIndexFromFile:dictPath];
+	}
+
+	// if we couldn't get the image, then fall back to the words themselves
+	if (!error && (index == nil)) {
+		NSString*	contents = [NSString stringWithContentsOfFile:wordsPath encoding:NSUTF8StringEncoding error:NULL];
+		if (contents == nil) {
+			NSLog(@"[PatternIndex +createPatternIndexForWordsFile:compiledTo:] - the words file %@ could not be read. This is a serious problem and needs to be looked into as soon as possible.", wordsPath);
+		} else {
+			index = [PatternIndex createPatternIndex:[contents componentsSeparatedByString:@"\n"]];
+		}
+	}
+
+	return index;
+}
+
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the number of distinct words that have been indexed.
+ Duplicates in the source list are only counted - and indexed - once.
+
+ @param
+ @return Count of unique words in the index
+ */
+- (NSUInteger) getWordCount
+{
+	return ([self getImage]->header != NULL ? [self getImage]->header->wordCount : 0);
+}
+
+
+/*!
+ This method returns the number of distinct patterns in the index. It's
+ really only interesting for logging and tuning, but it's nice to know.
+
+ @param
+ @return Count of unique patterns in the index
+ */
+- (NSUInteger) getPatternCount
+{
+	return ([self getImage]->header != NULL ? [self getImage]->header->bucketCount : 0);
+}
+
+
+//----------------------------------------------------------------------------
+//					Initialization Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method initializes the index with the provided array of plaintext
+ words. Each is placed in the list for its pattern, and empty strings as
+ well as duplicates are quietly skipped. The image is built in memory.
+
+ @param words The array of plaintext words to index
+ @return self
+ */
+- (id) initWithWords:(NSArray*)words
+{
+	if (self = [self init]) {
+		// the builder wants the words just as they'd be in the file
+		NSData*		text = [[words componentsJoinedByString:@"\n"] dataUsingEncoding:NSUTF8StringEncoding];
+		void*		img = NULL;
+		size_t		size = 0;
+		QDImage		image;
+		int			err = qd_build_image([text bytes], [text length], 0, 0, &img, &size);
+		if (err == 0) {
+			err = qd_attach(&image, img, size);
+		}
+		if (err != 0) {
+			NSLog(@"[PatternIndex -initWithWords:] - the image of the %lu words could not be built: %s. This is a serious allocation error and needs to be looked into as soon as possible.", (unsigned long)[words count], strerror(err));
+			free(img);
+		} else {
+			[self takeImage:&image];
+		}
+	}
+	return self;
+}
+
+
+/*!
+ This method initializes the index by mmap'ing the compiled image at the
+ provided path. Only the header is checked, so this is constant time. If
+ the file isn't a valid image, this returns nil.
+
+ @param path The path to the compiled QuipDict image
+ @return self
+ */
+- (id) initWithContentsOfFile:(NSString*)path
+{
+	if (self = [self init]) {
+		QDImage		image;
+		int			err = qd_open(&image, [path fileSystemRepresentation]);
+		if (err != 0) {
+			NSLog(@"[PatternIndex -initWithContentsOfFile:] - the compiled image %@ could not be opened: %s", path, strerror(err));
+			self = nil;
+		} else {
+			[self takeImage:&image];
+		}
+	}
+	return self;
+}
+
+
+//----------------------------------------------------------------------------
+//					Lookup Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the array of all the indexed words that have the
+ provided pattern - as created by +[CypherWord createPatternText:]. If
+ there are no such words, an empty array is returned - never nil.
+
+ The NSStrings for a pattern are only made the first time it's asked for,
+ and then they are cached. This can be called from many threads at once.
+
+ @param pattern The uniform pattern of the words to return
+ @return The array of all words having that pattern
+ */
+- (NSArray*) getWordsForPattern:(NSString*)pattern
+{
+	NSArray*	words = nil;
+	if (pattern != nil) {
+		@synchronized(self) {
+			words = [[self getPatterns] objectForKey:pattern];
+			if (words == nil) {
+				const char*		pat = [pattern UTF8String];
+				const QDBucket*	b = qd_find_bucket([self getImage], pat, strlen(pat));
+				if (b != NULL) {
+					NSMutableArray*	list = [[NSMutableArray alloc] initWithCapacity:b->count];
+					for (uint32_t i = 0; i < b->count; ++i) {
+						[list addObject:[NSString stringWithUTF8String:qd_word([self getImage], b->first + i)]];
+					}
+					words = list;
+				} else {
+					words = [NSArray array];
+				}
+				[[self getPatterns] setObject:words forKey:pattern];
+			}
+		}
+	}
+	return (words != nil ? words : [NSArray array]);
+}
+
+
+/*!
+ This method returns the array of all the indexed words that pattern
+ match the provided CypherWord. These are all the possible plaintexts
+ for that cypherword, and is exactly what a PuzzlePiece needs.
+
+ @param cw The CypherWord to find the possible plaintexts for
+ @return The array of all words having the pattern of the cypherword
+ */
+- (NSArray*) getWordsMatchingCypherWord:(CypherWord*)cw
+{
+	return [self getWordsForPattern:[cw getCypherPattern]];
+}
+
+
+/*!
+ This method returns the ids of all the indexed words that have the
+ provided pattern. The words of a pattern are all together in the index,
+ so it's just the range of them - and it's empty if there are no such
+ words. Nothing is allocated, and it can be called from many threads.
+
+ @param pattern The uniform pattern of the words to find
+ @return The range of the ids of all words having that pattern
+ */
+- (NSRange) getWordIdsForPattern:(NSString*)pattern
+{
+	NSRange		ids = NSMakeRange(0, 0);
+	if (pattern != nil) {
+		const char*		pat = [pattern UTF8String];
+		const QDBucket*	b = qd_find_bucket([self getImage], pat, strlen(pat));
+		if (b != NULL) {
+			ids = NSMakeRange(b->first, b->count);
+		}
+	}
+	return ids;
+}
+
+
+/*!
+ This method returns the ids of all the indexed words that pattern match
+ the provided CypherWord - the ids of the possible plaintexts for it.
+
+ @param cw The CypherWord to find the possible plaintexts for
+ @return The range of the ids of all words having the pattern of the cypherword
+ */
+- (NSRange) getWordIdsMatchingCypherWord:(CypherWord*)cw
+{
+	return [self getWordIdsForPattern:[cw getCypherPattern]];
+}
+
+
+/*!
+ This method returns the lowercase, NUL-terminated, text of the word with
+ the provided id - right out of the index, so it's only good for as long as
+ the index is around, and it's not to be changed.
+
+ @param wid The id of the word
+ @return The text of the word
+ */
+- (const char*) getWordText:(uint32_t)wid
+{
+	return qd_word([self getImage], wid);
+}
+
+
+/*!
+ This method returns the word with the provided id as an NSString. It's
+ made on every call, so it's for when the word is really needed - like a
+ solution being reported - and not for the search.
+
+ @param wid The id of the word
+ @return The word as a new NSString
+ */
+- (NSString*) getWord:(uint32_t)wid
+{
+	return [NSString stringWithUTF8String:[self getWordText:wid]];
+}
+
+
+//----------------------------------------------------------------------------
+//					NSObject Overridden Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method makes sure to call the super's -init and then allocation all the
+ things we're going to need to function properly.
+ */
+- (id) init
+{
+	if (self = [super init]) {
+		// make the cache of the words for each pattern we've looked up
+		NSMutableDictionary*	d = [[NSMutableDictionary alloc] init];
+		if (d == nil) {
+			NSLog(@"[PatternIndex -init] - the storage for the pattern map could not be created. This is a serious allocation error and needs to be looked into as soon as possible.");
+		} else {
+			[self setPatterns:d];
+		}
+	}
+	return self;
+}
+
+
+/*!
+ Because we have the image mapped, or allocated, we need to make sure that
+ we clean up after ourselves, and that's what we're going to be doing here.
+ */
+- (void) dealloc
+{
+	// drop the cache of the words we've made
+	[self setPatterns:nil];
+	// ...and unmap, or free, the image
+	qd_close(&_image);
+}
+
+
+/*!
+ This method returns a string that describes the contents of this guy in a
+ nice, human-readable format so that it's suitable for logging and debuggung.
+ */
+- (NSString*) description
+{
+	return [NSString stringWithFormat:@"[PatternIndex words:%lu, patterns:%lu, %s]", (unsigned long)[self getWordCount], (unsigned long)[self getPatternCount], ([self getImage]->mapped ? "mapped" : "in memory")];
+}
+
+@end
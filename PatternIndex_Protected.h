@@ -0,0 +1,82 @@
+//
+//  PatternIndex_Protected.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 5/30/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+
+// System Headers
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "PatternIndex.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Protected Data Types
+
+// Protected Constants
+
+// Protected Macros
+
+
+/*!
+ @category PatternIndex(Protected)
+ These are the 'protected' methods on the PatternIndex object. They are
+ protected as a category because they can do a lot more damage than good
+ in the wrong hands, but we want to keep everything well encapsulated so
+ we need these methods, we just don't want them in the public API that
+ everyone gets to see. So they are here.
+ */
+@interface PatternIndex (Protected)
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the compiled image of the words that this index is
+ built on. It's the real deal, and it's read-only, so please be careful.
+
+ @param
+ @return The QuipDict image holding all the words
+ */
+- (const QDImage*) getImage;
+
+/*!
+ This method sets the dictionary that caches the array of words for each
+ pattern that's been looked up. The words are in the image, but we don't
+ want to make the NSStrings for a pattern more than once.
+
+ @param map Dictionary of pattern strings to arrays of plaintext words
+ */
+- (void) setPatterns:(NSMutableDictionary*)map;
+
+/*!
+ This method returns the dictionary that caches the array of words for
+ each pattern that's been looked up. It's the real deal, so be careful.
+
+ @param
+ @return Dictionary of pattern strings to arrays of plaintext words
+ */
+- (NSMutableDictionary*) getPatterns;
+
+/*!
+ This method takes ownership of the in-memory, or mapped, image and wires
+ it into this index. Any existing image is closed, and the cache of words
+ for each pattern is cleared out as it'd no longer be valid.
+
+ @param image The QuipDict image to use - it's cleared by this call
+ @return YES if the image was taken by this index
+ */
+- (BOOL) takeImage:(QDImage*)image;
+
+@end
@@ -7,13 +7,14 @@
 //
 
 // Apple Headers
-#import <Cocoa/Cocoa.h>
+#import <Foundation/Foundation.h>
 
 // System Headers
 
 // Third Party Headers
 
 // Other Headers
+#include "MatchKernel.h"
 
 // Class Headers
 #import "CypherWord.h"
@@ -21,6 +22,7 @@
 // Superclass Headers
 
 // Forward Class Declarations
+@class PatternIndex;
 
 // Public Data Types
 
@@ -39,7 +41,14 @@
 @interface PuzzlePiece : NSObject {
 @private
 	CypherWord*		_cyphertext;
-	NSMutableArray*	_possiblePlaintexts;
+	NSArray*		_possiblePlaintexts;
+	NSData*			_possibleIds;
+	PatternIndex*	_wordIndex;
+	BOOL			_possiblesShared;
+	PuzzlePiece*	_possibleSource;
+	NSMutableData*	_possibleCodes;
+	NSUInteger		_codedCount;
+	MKColumns		_possibleColumns;
 }
 
 //----------------------------------------------------------------------------
@@ -72,12 +81,52 @@
  This method returns the array of possible plaintext words that match the
  length and structure of the cypherword. These can then be used as "tests"
  for decoding the cypherword and comparing it to each of these in turn.
+ They may well be shared with the PatternIndex, or with another piece of
+ the same pattern, so they are read-only - the protected methods are the
+ way to change them, and they make a copy of their own to change first.
+ If the possibles are the ids of words in the index, the strings are only
+ made the first time this is called - the search never needs them.
 
  @param
  @return The array of all the possible plaintext words that pattern match
 		 this cyphertext word
  */
-- (NSMutableArray*) getPossibles;
+- (NSArray*) getPossibles;
+
+/*!
+ This method returns the ids - in the PatternIndex they came from - of all
+ the possible plaintext words, packed one after the other, or NULL if the
+ possibles aren't from an index, but strings that were added one by one.
+ The count of them is -countOfPossibles.
+
+ @param
+ @return The ids of the possible plaintext words, or NULL
+ */
+- (const uint32_t*) getPossibleIds;
+
+/*!
+ This method returns the letter codes - as described in LetterCode.h - of
+ all the possible plaintext words, one after the other, each the length of
+ the cypherword. So the codes of the i-th possible are at i * length. They
+ are made when they're first asked for after the possibles change, so it's
+ best to ask for them once before starting a search on many threads. If
+ this piece is sharing the possibles of another, these are that piece's.
+
+ @param
+ @return The letter codes of all the possibles, back to back
+ */
+- (const uint8_t*) getPossibleCodes;
+
+/*!
+ This method returns the same letter codes as -getPossibleCodes, but laid
+ out by column - as described in MatchKernel.h - so that one legend can be
+ checked against all the possibles at once with mk_filter(). They are made
+ right along with the codes, and it's the real deal, so be careful.
+
+ @param
+ @return The letter codes of all the possibles, by column
+ */
+- (const MKColumns*) getPossibleColumns;
 
 //----------------------------------------------------------------------------
 //					Initialization Methods
@@ -114,19 +163,24 @@
  This method returns YES if the argument represents the same puzzle piece
  as this instance. That is not to say that they are identical, but that
  they have the same cyphertext, and same list of possible plain text words.
+ The cyphertext is compared by its letter codes, and possibles from an
+ index by their ids, so none of the strings of them are made to do it.
  */
 - (BOOL) isEqual:(id)obj;
 
 /*!
  With a custom -isEquals: method, we need to compute a good hashcode for
  this map. We're going to make it as simple as we can - simply summing up
- the -hash values offsetting each by a factor of 31.
+ the letter codes of the cyphertext, and the ids of the possibles, offsetting
+ each by a factor of 31.
  */
 - (NSUInteger) hash;
 
 /*!
  This method returns a string that describes the contents of this guy in a
  nice, human-readable format so that it's suitable for logging and debuggung.
+ It's the count of the possibles, and not the words, as those are only made
+ when they're needed for a solution.
  */
 - (NSString*) description;
 
@@ -198,4 +252,59 @@
  */
 - (BOOL) checkPlaintextForPossibleMatch:(NSString*)plain;
 
+/*!
+ This method replaces the possibles with all the words in the index that
+ have the same pattern as our CypherWord. Since the index is built once,
+ this is a single lookup - as opposed to running every word we know about
+ through -checkPlaintextForPossibleMatch:. Only the ids of the words are
+ kept - packed, and pointing into the index - and the strings are only made
+ if someone asks for them. If there's no index, or no CypherWord, this
+ method will return -1 indicating an error.
+
+ @param index The PatternIndex of all the plaintext words we know
+ @return The number of possible plaintext matches for this cypher word
+ */
+- (int) fillPossiblesFromIndex:(PatternIndex*)index;
+
+/*!
+ This method has this piece use the possibles of the provided piece - which
+ has to have the same pattern - along with its codes and columns, so that
+ they are only made once for all the pieces of a quip with that pattern.
+ Nothing is copied unless the possibles of this piece are changed later.
+ If there's no piece, or no CypherWord, this method will return -1
+ indicating an error.
+
+ @param piece The PuzzlePiece, of the same pattern, to share the possibles of
+ @return The number of possible plaintext matches for this cypher word
+ */
+- (int) sharePossiblesOf:(PuzzlePiece*)piece;
+
+/*!
+ This method returns the pattern of the cypherword, as the letter codes see
+ it: each letter the legend already knows about is the uppercase plaintext
+ letter it maps to, each of the others is where that letter first shows up
+ in the word, and anything else - an apostrophe, say - is its code, just
+ as it is, as it has to match exactly. Two pieces with the same one of
+ these have exactly the same possibles once they are pruned by that
+ legend, so they can share them - and "can't" and "about" never do.
+
+ @param key The legend to apply to the pattern
+ @return The pattern of the cypherword, with the known letters filled in
+ */
+- (NSString*) getPatternUsingLegend:(Legend*)key;
+
+/*!
+ This method removes all the possibles that can't be the decoding of the
+ cypherword with the provided legend - either a letter the legend knows
+ about decodes to something else, or the possible has a plaintext letter
+ that the legend already has under a different cypher letter. It's meant
+ to be run once, with the hint, before the search, so that the search
+ never has to look at - and reject - those possibles again. It returns
+ the number of possibles that are left, or -1 if there's no CypherWord.
+
+ @param key The legend the possibles have to be consistent with
+ @return The number of possible plaintext matches for this cypher word
+ */
+- (int) prunePossiblesUsingLegend:(Legend*)key;
+
 @end
@@ -9,13 +9,16 @@
 // Apple Headers
 
 // System Headers
+#include <ctype.h>
 
 // Third Party Headers
 
 // Other Headers
+#include "LetterCode.h"
 
 // Class Headers
 #import "PuzzlePiece_Protected.h"
+#import "PatternIndex.h"
 
 // Superclass Headers
 
@@ -76,17 +79,135 @@
  This method returns the array of possible plaintext words that match the
  length and structure of the cypherword. These can then be used as "tests"
  for decoding the cypherword and comparing it to each of these in turn.
+ They may well be shared with the PatternIndex, or with another piece of
+ the same pattern, so they are read-only - the protected methods are the
+ way to change them, and they make a copy of their own to change first.
+ If the possibles are the ids of words in the index, the strings are only
+ made the first time this is called - the search never needs them.
 
  @param
  @return The array of all the possible plaintext words that pattern match
          this cyphertext word
  */
-- (NSMutableArray*) getPossibles
+- (NSArray*) getPossibles
 {
+	// if we're sharing another piece's possibles, they're his to make
+	if (_possibleSource != nil) {
+		return [_possibleSource getPossibles];
+	}
+	// if they are only ids, then make the strings now that someone wants them
+	if ((_possiblePlaintexts == nil) && (_possibleIds != nil)) {
+		@synchronized(self) {
+			if ((_possiblePlaintexts == nil) && (_possibleIds != nil)) {
+				NSUInteger		count = [_possibleIds length] / sizeof(uint32_t);
+				const uint32_t*	ids = [_possibleIds bytes];
+				NSMutableArray*	list = [NSMutableArray arrayWithCapacity:count];
+				for (NSUInteger i = 0; i < count; ++i) {
+					[list addObject:[_wordIndex getWord:ids[i]]];
+				}
+				_possiblePlaintexts = list;
+			}
+		}
+	}
 	return _possiblePlaintexts;
 }
 
 
+/*!
+ This method returns the ids - in the PatternIndex they came from - of all
+ the possible plaintext words, packed one after the other, or NULL if the
+ possibles aren't from an index, but strings that were added one by one.
+ The count of them is -countOfPossibles.
+
+ @param
+ @return The ids of the possible plaintext words, or NULL
+ */
+- (const uint32_t*) getPossibleIds
+{
+	if (_possibleSource != nil) {
+		return [_possibleSource getPossibleIds];
+	}
+	return (_possibleIds != nil ? [_possibleIds bytes] : NULL);
+}
+
+
+/*!
+ This method returns the letter codes - as described in LetterCode.h - of
+ all the possible plaintext words, one after the other, each the length of
+ the cypherword. So the codes of the i-th possible are at i * length. They
+ are made when they're first asked for after the possibles change, so it's
+ best to ask for them once before starting a search on many threads. If
+ this piece is sharing the possibles of another, these are that piece's.
+
+ @param
+ @return The letter codes of all the possibles, back to back
+ */
+- (const uint8_t*) getPossibleCodes
+{
+	// if we're sharing another piece's possibles, they're its codes too
+	if (_possibleSource != nil) {
+		return [_possibleSource getPossibleCodes];
+	}
+	// see if they are missing, or out of date with the possibles
+	if ((_possibleCodes == nil) || (_codedCount != (NSUInteger)[self countOfPossibles])) {
+		@synchronized(self) {
+			NSUInteger	count = (NSUInteger)MAX([self countOfPossibles], 0);
+			if ((_possibleCodes == nil) || (_codedCount != count)) {
+				NSUInteger		len = [[self getCypherWord] length];
+				NSMutableData*	codes = [NSMutableData dataWithLength:(count * len)];
+				uint8_t*		dst = [codes mutableBytes];
+				if (_possibleIds != nil) {
+					// code them right out of the index - no strings needed
+					const uint32_t*	ids = [_possibleIds bytes];
+					for (NSUInteger i = 0; i < count; ++i) {
+						const char*	word = [_wordIndex getWordText:ids[i]];
+						size_t		wlen = strlen(word);
+						for (NSUInteger j = 0; j < len; ++j) {
+							dst[j] = (j < wlen ? lc_encode((unsigned char)word[j]) : LC_NONE);
+						}
+						dst += len;
+					}
+				} else {
+					for (NSString* pt in [self getPossibles]) {
+						[CypherWord encodeText:pt into:dst length:len];
+						dst += len;
+					}
+				}
+				// ...and the columns for the batch filter
+				mk_free(&_possibleColumns);
+				if (mk_build(&_possibleColumns, [codes bytes], (uint32_t)count, (uint32_t)len) != 0) {
+					NSLog(@"[PuzzlePiece -getPossibleCodes] - the columns of the codes of the %lu possibles could not be created. This is a serious allocation error and needs to be looked into as soon as possible.", (unsigned long)count);
+				}
+				_possibleCodes = codes;
+				_codedCount = count;
+			}
+		}
+	}
+	return [_possibleCodes bytes];
+}
+
+
+/*!
+ This method returns the same letter codes as -getPossibleCodes, but laid
+ out by column - as described in MatchKernel.h - so that one legend can be
+ checked against all the possibles at once with mk_filter(). They are made
+ right along with the codes, and it's the real deal, so be careful.
+
+ @param
+ @return The letter codes of all the possibles, by column
+ */
+- (const MKColumns*) getPossibleColumns
+{
+	// if we're sharing another piece's possibles, they're its columns too
+	if (_possibleSource != nil) {
+		return [_possibleSource getPossibleColumns];
+	}
+	// make sure they are up to date with the possibles
+	[self getPossibleCodes];
+	return &_possibleColumns;
+}
+
+
 //----------------------------------------------------------------------------
 //					Initialization Methods
 //----------------------------------------------------------------------------
@@ -144,10 +265,10 @@
  */
 - (void) dealloc
 {
-	// drop all the memory we're using
-	[self removeAllPossibles];
-	// ...and the array that held it
+	// drop the possibles - they may not be ours to clear out
 	[self setPossibles:nil];
+	// ...and the columns of the codes
+	mk_free(&_possibleColumns);
 }
 
 
@@ -155,14 +276,29 @@
  This method returns YES if the argument represents the same puzzle piece
  as this instance. That is not to say that they are identical, but that
  they have the same cyphertext, and same list of possible plain text words.
+ The cyphertext is compared by its letter codes, and possibles from an
+ index by their ids, so none of the strings of them are made to do it.
  */
 - (BOOL) isEqual:(id)obj
 {
 	BOOL	equal = NO;
 	if ([obj isKindOfClass:[self class]] &&
-		[[self getCypherWord] isEqual:[obj getCypherWord]] &&
-		[[self getPossibles] isEqualToArray:[obj getPossibles]]) {
-		equal = YES;
+		([[self getCypherWord] length] == [[obj getCypherWord] length]) &&
+		([self countOfPossibles] == [obj countOfPossibles])) {
+		NSUInteger		len = [[self getCypherWord] length];
+		NSUInteger		count = (NSUInteger)MAX([self countOfPossibles], 0);
+		const uint32_t*	mine = [self getPossibleIds];
+		const uint32_t*	his = [obj getPossibleIds];
+		if (memcmp([[self getCypherWord] getCode], [[obj getCypherWord] getCode], len) == 0) {
+			if ((mine != NULL) && (his != NULL)) {
+				// the ids are only the same words if they're in the same words
+				equal = (([self getWordIndex] == [obj getWordIndex]) &&
+						 (memcmp(mine, his, count * sizeof(uint32_t)) == 0));
+			} else if ((mine == NULL) && (his == NULL)) {
+				// ...and if they were added one by one, they're already strings
+				equal = [[self getPossibles] isEqualToArray:[obj getPossibles]];
+			}
+		}
 	}
 	return equal;
 }
@@ -171,15 +307,29 @@
 /*!
  With a custom -isEquals: method, we need to compute a good hashcode for
  this map. We're going to make it as simple as we can - simply summing up
- the -hash values offsetting each by a factor of 31.
+ the letter codes of the cyphertext, and the ids of the possibles, offsetting
+ each by a factor of 31.
  */
 - (NSUInteger) hash
 {
-	// start with the hash of the plain cyphertext string...
-	NSUInteger	hash = [[self getCypherWord] hash];
-	// ...now add in the hash of each of the possibles we have now
-	for (NSString* poss in [self getPossibles]) {
-		hash = 31*hash + [poss hash];
+	// start with the letter codes of the cyphertext...
+	NSUInteger		hash = 0;
+	const uint8_t*	code = [[self getCypherWord] getCode];
+	NSUInteger		len = [[self getCypherWord] length];
+	for (NSUInteger i = 0; i < len; ++i) {
+		hash = 31*hash + code[i];
+	}
+	// ...now add in the ids of the possibles - or the words, if they're all we have
+	const uint32_t*	ids = [self getPossibleIds];
+	if (ids != NULL) {
+		NSUInteger	count = (NSUInteger)MAX([self countOfPossibles], 0);
+		for (NSUInteger i = 0; i < count; ++i) {
+			hash = 31*hash + ids[i];
+		}
+	} else {
+		for (NSString* poss in [self getPossibles]) {
+			hash = 31*hash + [poss hash];
+		}
 	}
 	return hash;
 }
@@ -188,10 +338,12 @@
 /*!
  This method returns a string that describes the contents of this guy in a
  nice, human-readable format so that it's suitable for logging and debuggung.
+ It's the count of the possibles, and not the words, as those are only made
+ when they're needed for a solution.
  */
 - (NSString*) description
 {
-	return [NSString stringWithFormat:@"[cypherWord:%@, possibles:%@]", [[self getCypherWord] description], [[self getPossibles] description]];
+	return [NSString stringWithFormat:@"[cypherWord:%@, possibles:%d]", [[self getCypherWord] description], [self countOfPossibles]];
 }
 
 
@@ -252,8 +404,16 @@
 	// simply use the allocWithZone and populate it properly - easy
 	id	dup = [[PuzzlePiece allocWithZone:zone] initWithCypherText:[[self getCypherWord] getCypherText]];
 	// now let's add in all the possibles to the duplicate that we have now
-	for (NSString* poss in [self getPossibles]) {
-		[[dup getPossibles] addObject:[poss copyWithZone:zone]];
+	if ([self getPossibleIds] != NULL) {
+		NSUInteger	count = (NSUInteger)MAX([self countOfPossibles], 0);
+		[dup setPossibleIds:[NSData dataWithBytes:[self getPossibleIds] length:(count * sizeof(uint32_t))]
+				  fromIndex:[self getWordIndex]];
+	} else {
+		NSMutableArray*	poss = [NSMutableArray arrayWithCapacity:[[self getPossibles] count]];
+		for (NSString* pt in [self getPossibles]) {
+			[poss addObject:[pt copyWithZone:zone]];
+		}
+		[dup setPossibles:poss];
 	}
 	return dup;
 }
@@ -276,7 +436,12 @@
 - (int) countOfPossibles
 {
 	int		cnt = -1;
-	if ([self getPossibles] != nil) {
+	if (_possibleSource != nil) {
+		cnt = [_possibleSource countOfPossibles];
+	} else if (_possibleIds != nil) {
+		// don't make the strings just to count them
+		cnt = (int) ([_possibleIds length] / sizeof(uint32_t));
+	} else if ([self getPossibles] != nil) {
 		cnt = (int) [[self getPossibles] count];
 	}
 	return cnt;
@@ -297,15 +462,13 @@
 - (int) countOfPossiblesUsingLegend:(Legend*)key
 {
 	int		cnt = -1;
-	if (([self getCypherWord] != nil) && ([self getPossibles] != nil)) {
+	if (([self getCypherWord] != nil) && ([self countOfPossibles] >= 0)) {
 		// OK, there's something there to look into
 		cnt = 0;
-		// check each one for a possible match
-		for (NSString* pt in [self getPossibles]) {
-			if ([[self getCypherWord] canMatch:pt with:key]) {
-				++cnt;
-			}
-		}
+		// check them all at once for a possible match - on the letter codes
+		const MKColumns*	cols = [self getPossibleColumns];
+		uint64_t			live[mk_mask_words(cols->count) + 1];
+		cnt = (int) mk_filter(cols, [[self getCypherWord] getCode], [key getMap], live);
 	}
 	return cnt;
 }
@@ -330,4 +493,154 @@
 	return matched;
 }
 
+
+/*!
+ This method replaces the possibles with all the words in the index that
+ have the same pattern as our CypherWord. Since the index is built once,
+ this is a single lookup - as opposed to running every word we know about
+ through -checkPlaintextForPossibleMatch:. Only the ids of the words are
+ kept - packed, and pointing into the index - and the strings are only made
+ if someone asks for them. If there's no index, or no CypherWord, this
+ method will return -1 indicating an error.
+
+ @param index The PatternIndex of all the plaintext words we know
+ @return The number of possible plaintext matches for this cypher word
+ */
+- (int) fillPossiblesFromIndex:(PatternIndex*)index
+{
+	int		cnt = -1;
+	if ((index != nil) && ([self getCypherWord] != nil)) {
+		// the index has already done the pattern matching and de-duping
+		NSRange			range = [index getWordIdsMatchingCypherWord:[self getCypherWord]];
+		NSMutableData*	ids = [NSMutableData dataWithLength:(range.length * sizeof(uint32_t))];
+		uint32_t*		dst = [ids mutableBytes];
+		for (NSUInteger i = 0; i < range.length; ++i) {
+			dst[i] = (uint32_t)(range.location + i);
+		}
+		[self setPossibleIds:ids fromIndex:index];
+		cnt = [self countOfPossibles];
+	}
+	return cnt;
+}
+
+
+/*!
+ This method has this piece use the possibles of the provided piece - which
+ has to have the same pattern - along with its codes and columns, so that
+ they are only made once for all the pieces of a quip with that pattern.
+ Nothing is copied unless the possibles of this piece are changed later.
+ If there's no piece, or no CypherWord, this method will return -1
+ indicating an error.
+
+ @param piece The PuzzlePiece, of the same pattern, to share the possibles of
+ @return The number of possible plaintext matches for this cypher word
+ */
+- (int) sharePossiblesOf:(PuzzlePiece*)piece
+{
+	int		cnt = -1;
+	// follow his possibles - and not whoever he might be following
+	while ([piece getPossibleSource] != nil) {
+		piece = [piece getPossibleSource];
+	}
+	if ((piece != nil) && (piece != self) && ([self getCypherWord] != nil)) {
+		[self setPossibleSource:piece];
+		cnt = [self countOfPossibles];
+	}
+	return cnt;
+}
+
+
+/*!
+ This method returns the pattern of the cypherword, as the letter codes see
+ it: each letter the legend already knows about is the uppercase plaintext
+ letter it maps to, each of the others is where that letter first shows up
+ in the word, and anything else - an apostrophe, say - is its code, just
+ as it is, as it has to match exactly. Two pieces with the same one of
+ these have exactly the same possibles once they are pruned by that
+ legend, so they can share them - and "can't" and "about" never do.
+
+ @param key The legend to apply to the pattern
+ @return The pattern of the cypherword, with the known letters filled in
+ */
+- (NSString*) getPatternUsingLegend:(Legend*)key
+{
+	const uint8_t*	cw = [[self getCypherWord] getCode];
+	NSUInteger		len = [[self getCypherWord] length];
+	unichar*		map = [key getMap];
+	unichar			buff[len > 0 ? len : 1];
+	for (NSUInteger i = 0; i < len; ++i) {
+		uint8_t		c = cw[i];
+		if ((c & LC_PUNCT) != 0) {
+			// it's 0x80 and up, so it's never mistaken for a letter
+			buff[i] = c;
+		} else if (map[c] != '\0') {
+			buff[i] = (unichar)toupper(map[c]);
+		} else {
+			// ...and past all of them, where it first shows up
+			NSUInteger	first = 0;
+			while (cw[first] != c) {
+				++first;
+			}
+			buff[i] = (unichar)(0x100 + first);
+		}
+	}
+	return [NSString stringWithCharacters:buff length:len];
+}
+
+
+/*!
+ This method removes all the possibles that can't be the decoding of the
+ cypherword with the provided legend - either a letter the legend knows
+ about decodes to something else, or the possible has a plaintext letter
+ that the legend already has under a different cypher letter. It's meant
+ to be run once, with the hint, before the search, so that the search
+ never has to look at - and reject - those possibles again. It returns
+ the number of possibles that are left, or -1 if there's no CypherWord.
+
+ @param key The legend the possibles have to be consistent with
+ @return The number of possible plaintext matches for this cypher word
+ */
+- (int) prunePossiblesUsingLegend:(Legend*)key
+{
+	int		cnt = -1;
+	if ([self getCypherWord] != nil) {
+		const uint8_t*	cw = [[self getCypherWord] getCode];
+		const uint8_t*	codes = [self getPossibleCodes];
+		NSUInteger		len = [[self getCypherWord] length];
+		unichar*		map = [key getMap];
+		unichar*		rev = [key getReverseMap];
+		NSUInteger		count = (NSUInteger)MAX([self countOfPossibles], 0);
+		const uint32_t*	ids = [self getPossibleIds];
+		NSMutableData*	keepIds = [NSMutableData dataWithCapacity:(count * sizeof(uint32_t))];
+		NSArray*		poss = (ids == NULL ? [self getPossibles] : nil);
+		NSMutableArray*	keep = [NSMutableArray arrayWithCapacity:(ids == NULL ? count : 0)];
+		for (NSUInteger i = 0; i < count; ++i) {
+			const uint8_t*	pw = codes + i * len;
+			BOOL			ok = (lc_can_match(cw, pw, len, map) != 0);
+			/*
+			 The legend is one-to-one, so a plaintext letter it already has
+			 can only come from the cypher letter that it has it under.
+			 */
+			for (NSUInteger j = 0; ok && (j < len); ++j) {
+				if (((pw[j] & LC_PUNCT) == 0) && (rev[pw[j]] != '\0') && (cw[j] != rev[pw[j]] - 'a')) {
+					ok = NO;
+				}
+			}
+			if (ok && (ids != NULL)) {
+				[keepIds appendBytes:&ids[i] length:sizeof(uint32_t)];
+			} else if (ok) {
+				[keep addObject:[poss objectAtIndex:i]];
+			}
+		}
+		// only take on possibles of our own if something's been pruned
+		if ((ids != NULL) && ([keepIds length] != count * sizeof(uint32_t))) {
+			[self setPossibleIds:keepIds fromIndex:[self getWordIndex]];
+		} else if ((ids == NULL) && ([keep count] != count)) {
+			[self setPossibles:keep];
+		}
+		cnt = [self countOfPossibles];
+	}
+	return cnt;
+}
+
 @end
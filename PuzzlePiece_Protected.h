@@ -55,13 +55,73 @@
  This method sets the array we'll use for holding the possible plaintext
  words for the cypherword that we have been given. This is kind of serious
  as it'll drop any existing list and since we'll make one in the -init method
- we might want to be very careful calling this.
+ we might want to be very careful calling this. The array is ours to change,
+ and this piece stops sharing the possibles of any other.
 
  @param array An array of plaintext words that are possible matches to the
               cypher word in the PuzzlePiece
  */
 - (void) setPossibles:(NSMutableArray*)array;
 
+/*!
+ This method sets the possibles to an array that's someone else's - like
+ the PatternIndex's words for a pattern. It's never changed here, and the
+ first time the possibles are changed, they are copied into an array of
+ our own first.
+
+ @param array The read-only array of plaintext words that are possible
+              matches to the cypher word in the PuzzlePiece
+ */
+- (void) setSharedPossibles:(NSArray*)array;
+
+/*!
+ This method returns the possibles as an array that's ours to change -
+ copying them first if they are shared with the index, or another piece.
+ It's what all the methods that change the possibles use.
+
+ @param
+ @return The array of possible plaintext words, ready to be changed
+ */
+- (NSMutableArray*) getMutablePossibles;
+
+/*!
+ This method sets the possibles to the packed ids of words in the provided
+ PatternIndex - the strings are only made if someone asks for them. They
+ are never changed here, and the first time the possibles are changed,
+ the strings are made into an array of our own, and the ids are dropped.
+
+ @param ids The packed uint32_t ids of the possible plaintext words
+ @param index The PatternIndex the ids are for
+ */
+- (void) setPossibleIds:(NSData*)ids fromIndex:(PatternIndex*)index;
+
+/*!
+ This method returns the PatternIndex that the ids of the possibles are
+ for, or nil if the possibles aren't ids.
+
+ @param
+ @return The PatternIndex of the possible ids, or nil
+ */
+- (PatternIndex*) getWordIndex;
+
+/*!
+ This method sets the piece whose possibles - and their codes and columns -
+ this piece is using, or nil if it has its own. It has to have the same
+ pattern as this piece, or none of it makes sense.
+
+ @param piece The PuzzlePiece to share the possibles of, or nil
+ */
+- (void) setPossibleSource:(PuzzlePiece*)piece;
+
+/*!
+ This method returns the piece whose possibles this piece is using, or nil
+ if it has its own.
+
+ @param
+ @return The PuzzlePiece whose possibles are used, or nil
+ */
+- (PuzzlePiece*) getPossibleSource;
+
 /*!
  This method adds the provided plaintext word to the list of possibles for
  this piece of the puzzle. This method DOES NOT check to see if the plaintext
@@ -59,7 +59,8 @@
  This method sets the array we'll use for holding the possible plaintext
  words for the cypherword that we have been given. This is kind of serious
  as it'll drop any existing list and since we'll make one in the -init method
- we might want to be very careful calling this.
+ we might want to be very careful calling this. The array is ours to change,
+ and this piece stops sharing the possibles of any other.
 
  @param array An array of plaintext words that are possible matches to the
               cypher word in the PuzzlePiece
@@ -67,6 +68,114 @@
 - (void) setPossibles:(NSMutableArray*)array
 {
 	_possiblePlaintexts = array;
+	_possibleIds = nil;
+	_wordIndex = nil;
+	_possiblesShared = NO;
+	_possibleSource = nil;
+	// ...the codes are for the old possibles, so they are no good anymore
+	_possibleCodes = nil;
+}
+
+
+/*!
+ This method sets the possibles to an array that's someone else's - like
+ the PatternIndex's words for a pattern. It's never changed here, and the
+ first time the possibles are changed, they are copied into an array of
+ our own first.
+
+ @param array The read-only array of plaintext words that are possible
+              matches to the cypher word in the PuzzlePiece
+ */
+- (void) setSharedPossibles:(NSArray*)array
+{
+	_possiblePlaintexts = array;
+	_possibleIds = nil;
+	_wordIndex = nil;
+	_possiblesShared = YES;
+	_possibleSource = nil;
+	// ...the codes are for the old possibles, so they are no good anymore
+	_possibleCodes = nil;
+}
+
+
+/*!
+ This method returns the possibles as an array that's ours to change -
+ copying them first if they are shared with the index, or another piece.
+ It's what all the methods that change the possibles use.
+
+ @param
+ @return The array of possible plaintext words, ready to be changed
+ */
+- (NSMutableArray*) getMutablePossibles
+{
+	// if they aren't ours, then make them ours before anyone changes them
+	if (_possiblesShared || (_possibleSource != nil) || (_possibleIds != nil)) {
+		NSArray*	poss = [self getPossibles];
+		[self setPossibles:(poss != nil ? [poss mutableCopy] : nil)];
+	}
+	return (NSMutableArray*)_possiblePlaintexts;
+}
+
+
+/*!
+ This method sets the possibles to the packed ids of words in the provided
+ PatternIndex - the strings are only made if someone asks for them. They
+ are never changed here, and the first time the possibles are changed,
+ the strings are made into an array of our own, and the ids are dropped.
+
+ @param ids The packed uint32_t ids of the possible plaintext words
+ @param index The PatternIndex the ids are for
+ */
+- (void) setPossibleIds:(NSData*)ids fromIndex:(PatternIndex*)index
+{
+	_possibleIds = ids;
+	_wordIndex = index;
+	_possiblePlaintexts = nil;
+	_possiblesShared = NO;
+	_possibleSource = nil;
+	// ...the codes are for the old possibles, so they are no good anymore
+	_possibleCodes = nil;
+}
+
+
+/*!
+ This method returns the PatternIndex that the ids of the possibles are
+ for, or nil if the possibles aren't ids.
+
+ @param
+ @return The PatternIndex of the possible ids, or nil
+ */
+- (PatternIndex*) getWordIndex
+{
+	return (_possibleSource != nil ? [_possibleSource getWordIndex] : _wordIndex);
+}
+
+
+/*!
+ This method sets the piece whose possibles - and their codes and columns -
+ this piece is using, or nil if it has its own. It has to have the same
+ pattern as this piece, or none of it makes sense.
+
+ @param piece The PuzzlePiece to share the possibles of, or nil
+ */
+- (void) setPossibleSource:(PuzzlePiece*)piece
+{
+	_possibleSource = piece;
+	// ...and our codes, if we had any, are no longer the ones to use
+	_possibleCodes = nil;
+}
+
+
+/*!
+ This method returns the piece whose possibles this piece is using, or nil
+ if it has its own.
+
+ @param
+ @return The PuzzlePiece whose possibles are used, or nil
+ */
+- (PuzzlePiece*) getPossibleSource
+{
+	return _possibleSource;
 }
 
 
@@ -99,7 +208,8 @@
 			NSLog(@"[PuzzlePiece (Protected) -addToPossibles:] - the master storage of all possible plaintext words has not been created. This means that the -init method has probably not been called. Please make sure to properly initialize this object before using it.");
 		} else {
 			// add him if things are OK to this point
-			[[self getPossibles] addObject:word];
+			[[self getMutablePossibles] addObject:word];
+			_possibleCodes = nil;
 		}
 	}
 	
@@ -132,8 +242,9 @@
 			error = YES;
 			NSLog(@"[PuzzlePiece (Protected) -removeFromPossibles:] - the master storage of all possible plaintext words has not been created. This means that the -init method has probably not been called. Please make sure to properly initialize this object before using it.");
 		} else {
-			// add him if things are OK to this point
-			[[self getPossibles] removeObject:word];
+			// yank him if things are OK to this point
+			[[self getMutablePossibles] removeObject:word];
+			_possibleCodes = nil;
 		}
 	}
 	
@@ -150,8 +261,9 @@
 	if ([self getPossibles] == nil) {
 		NSLog(@"[PuzzlePiece (Protected) -removeAllPossibles] - the master storage of all possible plaintext words has not been created. This means that the -init method has probably not been called. Please make sure to properly initialize this object before using it.");
 	} else {
-		// add him if things are OK to this point
-		[[self getPossibles] removeAllObjects];
+		// clear them all out if things are OK to this point
+		[[self getMutablePossibles] removeAllObjects];
+		_possibleCodes = nil;
 	}
 }
 
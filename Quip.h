@@ -7,13 +7,14 @@
 //
 
 // Apple Headers
-#import <Cocoa/Cocoa.h>
+#import <Foundation/Foundation.h>
 
 // System Headers
 
 // Third Party Headers
 
 // Other Headers
+#include "NogoodTable.h"
 
 // Class Headers
 #import "PuzzlePiece.h"
@@ -21,8 +22,67 @@
 // Superclass Headers
 
 // Forward Class Declarations
+@class PatternIndex;
 
 // Public Data Types
+/*!
+ These are the options for the "Word Block" attack, and they can be or'ed
+ together. QuipAttackSerial is the original attack - on the calling thread,
+ with the words in the order of the fewest possibles first.
+
+ QuipAttackParallel splits up the search and runs it on all the cores.
+
+ QuipAttackDynamicOrder picks the next word to try at each step in the
+ search as the one with the fewest possibles that are still consistent
+ with the legend so far - and gives up as soon as any word has none.
+
+ QuipAttackForwardCheck narrows the possibles of the rest of the words
+ each time a word is added to the legend, and backs up as soon as any of
+ them has none left - rather than waiting to get to that word to find out.
+ */
+typedef NSUInteger QuipAttackOptions;
+enum {
+	QuipAttackSerial = 0,
+	QuipAttackParallel = (1 << 0),
+	QuipAttackDynamicOrder = (1 << 1),
+	QuipAttackForwardCheck = (1 << 2),
+};
+
+/*!
+ This is the block that's handed each solution as it's found - the legend
+ that decodes the quip, and the plaintext it decodes to. The legend is a
+ copy, so it's the caller's to keep. With the parallel attack, this will be
+ called on the worker threads, but only one at a time.
+ */
+typedef void (^QuipSolutionHandler)(Legend* legend, NSString* plaintext);
+
+/*!
+ These are the counters of what the last attack did - where it spent its
+ time, and why. They are only kept when the solver is built with
+ QUIP_INSTRUMENTATION defined, so that they cost nothing at all when they
+ aren't wanted. The possibles checked, and rejected, are the ones run
+ through the filter against a legend - what -canMatch:with: used to do.
+ The nodes deeper than the last depth counted are counted there. The
+ nogoods are the places in the search that were looked up in, and stored
+ in, the table of the ones with no solutions below them - and the hits
+ are the subtrees that didn't have to be searched again.
+ */
+#define QUIP_STAT_DEPTHS	32
+typedef struct {
+	uint64_t		nodesAtDepth[QUIP_STAT_DEPTHS];	// nodes by depth in the search
+	uint64_t		matchChecks;			// possibles checked against a legend
+	uint64_t		matchRejects;			// ...and the ones that didn't match
+	uint64_t		incorporates;			// words added to a legend
+	uint64_t		incorporateFailures;	// ...and the ones that wouldn't fit
+	uint64_t		legendCopies;			// legends copied
+	uint64_t		backtracks;				// words taken back out of a legend
+	uint64_t		backjumps;				// ...and the levels jumped back over
+	uint64_t		maxDepth;				// the deepest the search got
+	uint64_t		nogoodProbes;			// places looked up in the nogoods
+	uint64_t		nogoodHits;				// ...and the ones that were there
+	uint64_t		nogoodStores;			// places put in the nogoods
+	NSTimeInterval	firstSolutionTime;		// seconds to the first solution
+} QuipStatistics;
 
 // Public Constants
 
@@ -41,6 +101,21 @@
 	Legend*			_startingLegend;
 	NSMutableArray*	_puzzlePieces;
 	NSMutableArray*	_solutions;
+	volatile BOOL	_cancelled;
+	NSMutableSet*	_solutionKeys;
+	NSUInteger		_solutionLimit;
+	QuipSolutionHandler	_solutionHandler;
+	volatile uint64_t	_nodeCount;
+	volatile NSUInteger	_currentDepth;
+	NSTimeInterval		_prepareTime;
+	NSTimeInterval		_searchTime;
+	NSTimeInterval		_searchStart;
+	QuipStatistics		_statistics;
+	MKPairTable*		_pairTables;
+	NSArray*			_pairedPieces;
+	NSArray*			_componentQuips;
+	NGTable				_nogoods;
+	uint32_t*			_remainingLetters;
 }
 
 //----------------------------------------------------------------------------
@@ -73,6 +148,67 @@
  */
 - (NSMutableArray*) getSolutions;
 
+/*!
+ This method returns the set of legends - one for each of the solutions -
+ that have been arrived at by one of the attack plans. It's what's used to
+ make sure that each solution is only counted once, and it's the way to
+ see the keys to the puzzle, and not just the plaintexts.
+ */
+- (NSMutableSet*) getSolutionKeys;
+
+/*!
+ This method returns the number of nodes in the search tree that the last
+ attack looked at - the number of legends it had to find the next word
+ for. It's the measure of how much work the attack did, no matter how fast
+ the box is.
+ */
+- (uint64_t) getNodeCount;
+
+/*!
+ This method returns how deep the search is right now - the number of
+ words it has in the legend it's looking at. It's only a snapshot, and
+ with the parallel attack it's whichever thread got there last, but it's
+ just the thing for showing the progress of a long search.
+ */
+- (NSUInteger) getCurrentDepth;
+
+/*!
+ This method returns the time, in seconds, the last attack took to get
+ ready to search - sorting the pieces and getting their possibles coded.
+ */
+- (NSTimeInterval) getPrepareTime;
+
+/*!
+ This method returns the time, in seconds, the last attack spent in the
+ search itself - from the end of the preparations to the last solution.
+ */
+- (NSTimeInterval) getSearchTime;
+
+/*!
+ This method returns the statistics of the last attack - the counts of the
+ nodes at each depth, the possibles checked and rejected, the words added
+ to the legend and the ones that wouldn't fit, the legend copies, the
+ backtracks and backjumps, the deepest the search got, the lookups, hits
+ and stores of the nogoods, and the time to the first solution - as a
+ dictionary. If the solver wasn't built with QUIP_INSTRUMENTATION defined,
+ there's nothing to return, and this is nil.
+ */
+- (NSDictionary*) getStatistics;
+
+/*!
+ This method returns the statistics of the last attack as a single line -
+ just right for a log, or a status line. If the solver wasn't built with
+ QUIP_INSTRUMENTATION defined, this is nil.
+ */
+- (NSString*) getStatisticsSummary;
+
+/*!
+ This method returns YES if the attack that's running - or the last one
+ that ran - has been told to stop. This happens when someone calls
+ -cancelAttack, or when a parallel attack has all the solutions it needs.
+ */
+- (BOOL) isCancelled;
+
 //----------------------------------------------------------------------------
 //					Initialization Methods
 //----------------------------------------------------------------------------
@@ -104,6 +240,22 @@
  */
 - (id) initWithCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain usingDict:(NSArray*)dict;
 
+/*!
+ This initialization method will set up the quip to use the provided cyphertext
+ and the legend created with the provided character mapping. Rather than a
+ list of "known" plaintext words, this takes the PatternIndex of those words,
+ so that each of the parts of the puzzle can be populated with its potential
+ matches with a single lookup. If you are solving more than one Quip with
+ the same words, build the index once and use this guy.
+
+ @param text The source cyphertext to decode
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param index The PatternIndex of all the known plaintext words
+ @return self, after proper initialization
+ */
+- (id) initWithCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain usingIndex:(PatternIndex*)index;
+
 //----------------------------------------------------------------------------
 //					NSObject Overridden Methods
 //----------------------------------------------------------------------------
@@ -169,4 +321,59 @@
  */
 - (BOOL) attemptWordBlockAttack;
 
+/*!
+ This is the parallel version of the "Word Block" attack. The search tree
+ is split up into tasks - one for each legend that's consistent with the
+ first one or two cypherwords - and those are run on the shared WorkPool,
+ so one hard quip can use every core on the box. As soon as a solution is
+ found, the rest of the tasks are cancelled, and they stop where they are.
+
+ As with the serial attack, if this results in a successful decoding of the
+ cyphertext, this method will return YES, otherwise, it will return NO.
+
+ @param
+ @return YES or NO based on the successful outcome of the attck
+ */
+- (BOOL) attemptParallelWordBlockAttack;
+
+/*!
+ This is the "Word Block" attack with the options that say how it's to be
+ run - serially or in parallel, and the order in which the words are to
+ be tried. The options can be or'ed together, and QuipAttackSerial is
+ the plain, original, attack.
+
+ If this attack results in a successful decoding of the cyphertext, this
+ method will return YES, otherwise, it will return NO.
+
+ @param options The QuipAttackOptions for this attack
+ @return YES or NO based on the successful outcome of the attck
+ */
+- (BOOL) attemptWordBlockAttackWithOptions:(QuipAttackOptions)options;
+
+/*!
+ This is the "Word Block" attack that doesn't stop at the first solution.
+ It keeps going until it has found 'limit' distinct solutions - or all of
+ them, if the limit is zero - and each one is handed to the handler as
+ it's found, so the caller doesn't have to wait for the whole search to
+ see the first answer. Solutions are distinct if their legends are, and
+ that's checked by the hash of the legend, so it's quick no matter how
+ many there are.
+
+ If this attack results in at least one successful decoding of the
+ cyphertext, this method will return YES, otherwise, it will return NO.
+
+ @param options The QuipAttackOptions for this attack
+ @param limit The most solutions to find, or zero for all of them
+ @param handler The block to call with each solution, or nil
+ @return YES or NO based on the successful outcome of the attck
+ */
+- (BOOL) attemptWordBlockAttackWithOptions:(QuipAttackOptions)options limit:(NSUInteger)limit solutionHandler:(QuipSolutionHandler)handler;
+
+/*!
+ This method tells the attack that's running to stop as soon as it can. It
+ can be called from any thread, and the attack will check for it at every
+ word it tries, so it won't be long.
+ */
+- (void) cancelAttack;
+
 @end
@@ -9,6 +9,7 @@
 // Apple Headers
 
 // System Headers
+#include <string.h>
 
 // Third Party Headers
 
@@ -16,6 +17,8 @@
 
 // Class Headers
 #import "Quip_Protected.h"
+#import "PatternIndex.h"
+#import "WorkPool.h"
 
 // Superclass Headers
 
@@ -24,6 +27,13 @@
 // Private Data Types
 
 // Private Constants
+/*!
+ The parallel attack splits the search until it has about this many tasks
+ for each worker - so that stealing can even out the load - but it will
+ never split more than this many cypherwords deep.
+ */
+#define PARALLEL_TASKS_PER_WORKER	8
+#define PARALLEL_MAX_SPLIT_DEPTH	2
 
 // Private Macros
 
@@ -83,6 +93,141 @@
 }
 
 
+/*!
+ This method returns the set of legends - one for each of the solutions -
+ that have been arrived at by one of the attack plans. It's what's used to
+ make sure that each solution is only counted once, and it's the way to
+ see the keys to the puzzle, and not just the plaintexts.
+ */
+- (NSMutableSet*) getSolutionKeys
+{
+	return _solutionKeys;
+}
+
+
+/*!
+ This method returns the number of nodes in the search tree that the last
+ attack looked at - the number of legends it had to find the next word
+ for. It's the measure of how much work the attack did, no matter how fast
+ the box is.
+ */
+- (uint64_t) getNodeCount
+{
+	return _nodeCount;
+}
+
+
+/*!
+ This method returns how deep the search is right now - the number of
+ words it has in the legend it's looking at. It's only a snapshot, and
+ with the parallel attack it's whichever thread got there last, but it's
+ just the thing for showing the progress of a long search.
+ */
+- (NSUInteger) getCurrentDepth
+{
+	return _currentDepth;
+}
+
+
+/*!
+ This method returns the time, in seconds, the last attack took to get
+ ready to search - sorting the pieces and getting their possibles coded.
+ */
+- (NSTimeInterval) getPrepareTime
+{
+	return _prepareTime;
+}
+
+
+/*!
+ This method returns the time, in seconds, the last attack spent in the
+ search itself - from the end of the preparations to the last solution.
+ */
+- (NSTimeInterval) getSearchTime
+{
+	return _searchTime;
+}
+
+
+/*!
+ This method returns the statistics of the last attack - the counts of the
+ nodes at each depth, the possibles checked and rejected, the words added
+ to the legend and the ones that wouldn't fit, the legend copies, the
+ backtracks and backjumps, the deepest the search got, the lookups, hits
+ and stores of the nogoods, and the time to the first solution - as a
+ dictionary. If the solver wasn't built with QUIP_INSTRUMENTATION defined,
+ there's nothing to return, and this is nil.
+ */
+- (NSDictionary*) getStatistics
+{
+	NSDictionary*	stats = nil;
+#ifdef QUIP_INSTRUMENTATION
+	// only show the depths the search got to
+	NSMutableArray*	depths = [NSMutableArray array];
+	NSUInteger		deepest = (_statistics.maxDepth < QUIP_STAT_DEPTHS ? (NSUInteger)_statistics.maxDepth : QUIP_STAT_DEPTHS - 1);
+	for (NSUInteger d = 0; d <= deepest; ++d) {
+		[depths addObject:[NSNumber numberWithUnsignedLongLong:_statistics.nodesAtDepth[d]]];
+	}
+	stats = [NSDictionary dictionaryWithObjectsAndKeys:
+				[NSNumber numberWithUnsignedLongLong:[self getNodeCount]], @"nodes",
+				depths, @"nodesAtDepth",
+				[NSNumber numberWithUnsignedLongLong:_statistics.matchChecks], @"matchChecks",
+				[NSNumber numberWithUnsignedLongLong:_statistics.matchRejects], @"matchRejects",
+				[NSNumber numberWithUnsignedLongLong:_statistics.incorporates], @"incorporates",
+				[NSNumber numberWithUnsignedLongLong:_statistics.incorporateFailures], @"incorporateFailures",
+				[NSNumber numberWithUnsignedLongLong:_statistics.legendCopies], @"legendCopies",
+				[NSNumber numberWithUnsignedLongLong:_statistics.backtracks], @"backtracks",
+				[NSNumber numberWithUnsignedLongLong:_statistics.backjumps], @"backjumps",
+				[NSNumber numberWithUnsignedLongLong:_statistics.maxDepth], @"maxDepth",
+				[NSNumber numberWithUnsignedLongLong:_statistics.nogoodProbes], @"nogoodProbes",
+				[NSNumber numberWithUnsignedLongLong:_statistics.nogoodHits], @"nogoodHits",
+				[NSNumber numberWithUnsignedLongLong:_statistics.nogoodStores], @"nogoodStores",
+				[NSNumber numberWithDouble:(_statistics.firstSolutionTime * 1000)], @"firstSolutionMsec",
+				nil];
+#endif
+	return stats;
+}
+
+
+/*!
+ This method returns the statistics of the last attack as a single line -
+ just right for a log, or a status line. If the solver wasn't built with
+ QUIP_INSTRUMENTATION defined, this is nil.
+ */
+- (NSString*) getStatisticsSummary
+{
+	NSString*	summary = nil;
+#ifdef QUIP_INSTRUMENTATION
+	summary = [NSString stringWithFormat:@"nodes=%llu depth=%llu checks=%llu rejects=%llu incorporated=%llu failed=%llu copies=%llu backtracks=%llu backjumps=%llu nogood_hits=%llu/%llu nogood_stores=%llu first_ms=%.3f",
+					(unsigned long long)[self getNodeCount],
+					(unsigned long long)_statistics.maxDepth,
+					(unsigned long long)_statistics.matchChecks,
+					(unsigned long long)_statistics.matchRejects,
+					(unsigned long long)_statistics.incorporates,
+					(unsigned long long)_statistics.incorporateFailures,
+					(unsigned long long)_statistics.legendCopies,
+					(unsigned long long)_statistics.backtracks,
+					(unsigned long long)_statistics.backjumps,
+					(unsigned long long)_statistics.nogoodHits,
+					(unsigned long long)_statistics.nogoodProbes,
+					(unsigned long long)_statistics.nogoodStores,
+					(_statistics.firstSolutionTime * 1000)];
+#endif
+	return summary;
+}
+
+
+/*!
+ This method returns YES if the attack that's running - or the last one
+ that ran - has been told to stop. This happens when someone calls
+ -cancelAttack, or when a parallel attack has all the solutions it needs.
+ */
+- (BOOL) isCancelled
+{
+	return _cancelled;
+}
+
+
 //----------------------------------------------------------------------------
 //					Initialization Methods
 //----------------------------------------------------------------------------
@@ -117,27 +262,73 @@
  @return self, after proper initialization
  */
 - (id) initWithCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain usingDict:(NSArray*)dict
+{
+	// index the words by pattern so that each piece is a simple lookup
+	PatternIndex*	index = nil;
+	if (dict != nil) {
+		index = [PatternIndex createPatternIndex:dict];
+	}
+	return [self initWithCypherText:text where:cypher equals:plain usingIndex:index];
+}
+
+
+/*!
+ This initialization method will set up the quip to use the provided cyphertext
+ and the legend created with the provided character mapping. Rather than a
+ list of "known" plaintext words, this takes the PatternIndex of those words,
+ so that each of the parts of the puzzle can be populated with its potential
+ matches with a single lookup. If you are solving more than one Quip with
+ the same words, build the index once and use this guy.
+
+ @param text The source cyphertext to decode
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param index The PatternIndex of all the known plaintext words
+ @return self, after proper initialization
+ */
+- (id) initWithCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain usingIndex:(PatternIndex*)index
 {
 	if (self = [self init]) {
 		// save the important arguments as ivars
 		[self setCypherText:text];
 		[self setStartingLegend:[Legend createLegendWhere:cypher equals:plain]];
-		// now let's parse the cyphertext into puzzle pieces
+		/*
+		 Now let's parse the cyphertext into puzzle pieces - only one for
+		 each distinct cypherword, as a word that's repeated has to decode
+		 the same way every time, so there's nothing to gain by having it
+		 in the search more than once. The set makes that a hash lookup.
+		 */
 		PuzzlePiece*	pp = nil;
+		NSMutableSet*	seen = [NSMutableSet set];
 		for (NSString* cw in [text componentsSeparatedByString:@" "]) {
-			if ([cw length] > 0) {
+			if (([cw length] > 0) && ![seen containsObject:cw]) {
+				[seen addObject:cw];
 				if ((pp = [PuzzlePiece createPuzzlePiece:cw]) != nil) {
-					if (![[self getPuzzlePieces] containsObject:pp]) {
-						[self addToPuzzlePieces:pp];
-					}
+					[self addToPuzzlePieces:pp];
 				}
 			}
 		}
-		// if we have a dictionary of words, use them
-		if (dict != nil) {
-			for (NSString* pw in dict) {
-				for (PuzzlePiece* pp in [self getPuzzlePieces]) {
-					[pp checkPlaintextForPossibleMatch:pw];
+		/*
+		 If we have an index of words, use it to fill in the possibles, and
+		 then prune out the ones that don't fit with the hint, so the search
+		 never has to look at them. The pieces with the same pattern - and
+		 the hint, and any punctuation, in the same places - all end up with
+		 the same possibles, so the first one of each gets them from the
+		 index, and the rest share his - codes, columns and all - rather
+		 than each making them.
+		 */
+		if (index != nil) {
+			Legend*					hint = [self getStartingLegend];
+			NSMutableDictionary*	byPattern = [NSMutableDictionary dictionary];
+			for (PuzzlePiece* pp in [self getPuzzlePieces]) {
+				NSString*		pattern = [pp getPatternUsingLegend:hint];
+				PuzzlePiece*	first = [byPattern objectForKey:pattern];
+				if (first != nil) {
+					[pp sharePossiblesOf:first];
+				} else {
+					[pp fillPossiblesFromIndex:index];
+					[pp prunePossiblesUsingLegend:hint];
+					[byPattern setObject:pp forKey:pattern];
 				}
 			}
 		}
@@ -172,6 +363,14 @@
 		} else {
 			[self setSolutions:a];
 		}
+
+		// ...and a set to hold the legends of those solutions
+		NSMutableSet*		keys = [[NSMutableSet alloc] init];
+		if (keys == nil) {
+			NSLog(@"[Quip -init] - the storage for the legends of all the solutions to the puzzle could not be created. This is a serious allocation error and needs to be looked into as soon as possible.");
+		} else {
+			[self setSolutionKeys:keys];
+		}
 	}
 	return self;	
 }
@@ -188,6 +387,10 @@
 	[self removeAllPuzzlePieces];
 	// ...and the array that held it
 	[self setPuzzlePieces:nil];
+	// ...and the tables of the pairs of them
+	[self freePairTables];
+	// ...and the dead ends of the last search
+	[self freeNogoodTable];
 }
 
 
@@ -273,13 +476,165 @@
  */
 - (BOOL) attemptWordBlockAttack
 {
-	// sort the puzzle pieces by the number of possible words they match
-	[[self getPuzzlePieces] sortUsingSelector:@selector(comparePossibles:)];
-	// ...now run through the standard block attack
+	return [self attemptWordBlockAttackWithOptions:QuipAttackSerial];
+}
+
+
+/*!
+ This is the parallel version of the "Word Block" attack. The search tree
+ is split up into tasks - one for each legend that's consistent with the
+ first one or two cypherwords - and those are run on the shared WorkPool,
+ so one hard quip can use every core on the box. As soon as a solution is
+ found, the rest of the tasks are cancelled, and they stop where they are.
+
+ As with the serial attack, if this results in a successful decoding of the
+ cyphertext, this method will return YES, otherwise, it will return NO.
+
+ @param
+ @return YES or NO based on the successful outcome of the attck
+ */
+- (BOOL) attemptParallelWordBlockAttack
+{
+	return [self attemptWordBlockAttackWithOptions:QuipAttackParallel];
+}
+
+
+/*!
+ This is the "Word Block" attack with the options that say how it's to be
+ run - serially or in parallel, and the order in which the words are to
+ be tried. The options can be or'ed together, and QuipAttackSerial is
+ the plain, original, attack.
+
+ If this attack results in a successful decoding of the cyphertext, this
+ method will return YES, otherwise, it will return NO.
+
+ @param options The QuipAttackOptions for this attack
+ @return YES or NO based on the successful outcome of the attck
+ */
+- (BOOL) attemptWordBlockAttackWithOptions:(QuipAttackOptions)options
+{
+	return [self attemptWordBlockAttackWithOptions:options limit:1 solutionHandler:nil];
+}
+
+
+/*!
+ This is the "Word Block" attack that doesn't stop at the first solution.
+ It keeps going until it has found 'limit' distinct solutions - or all of
+ them, if the limit is zero - and each one is handed to the handler as
+ it's found, so the caller doesn't have to wait for the whole search to
+ see the first answer. Solutions are distinct if their legends are, and
+ that's checked by the hash of the legend, so it's quick no matter how
+ many there are.
+
+ If this attack results in at least one successful decoding of the
+ cyphertext, this method will return YES, otherwise, it will return NO.
+
+ @param options The QuipAttackOptions for this attack
+ @param limit The most solutions to find, or zero for all of them
+ @param handler The block to call with each solution, or nil
+ @return YES or NO based on the successful outcome of the attck
+ */
+- (BOOL) attemptWordBlockAttackWithOptions:(QuipAttackOptions)options limit:(NSUInteger)limit solutionHandler:(QuipSolutionHandler)handler
+{
+	// start with a clean slate, and the limit and handler for this attack
+	[self removeAllSolutions];
+	[self setSolutionLimit:limit];
+	[self setSolutionHandler:handler];
+	_nodeCount = 0;
+	_currentDepth = 0;
+	_prepareTime = 0.0;
+	_searchTime = 0.0;
+	memset(&_statistics, 0, sizeof(QuipStatistics));
+
+	NSUInteger	count = [[self getPuzzlePieces] count];
+	if (count == 0) {
+		[self setSolutionHandler:nil];
+		return NO;
+	}
+
+	// sort the pieces, and get them ready for the search
+	NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+	[self prepareForAttack];
+	// ...see if it falls apart into puzzles that have nothing to do with each other
+	NSArray*	components = [self getComponents];
+	// ...and forward checking narrows with the tables of the pairs
+	if (((options & QuipAttackForwardCheck) != 0) && ([components count] < 2)) {
+		[self buildPairTables];
+	}
+	// ...and the search remembers its dead ends
+	if ([components count] < 2) {
+		[self resetNogoodTable];
+	}
 	NSTimeInterval begin = [NSDate timeIntervalSinceReferenceDate];
-	BOOL ans = [self doWordBlockAttackOnIndex:0 withLegend:[self getStartingLegend]];
-	NSLog(@"%lu Solution(s) took %f msec", (unsigned long)[[self getSolutions] count], ([NSDate timeIntervalSinceReferenceDate] - begin) * 1000);
+	_prepareTime = begin - start;
+	_searchStart = begin;
+
+	BOOL		ans = NO;
+	if ([components count] > 1) {
+		// ...solve each part on its own, and put the answers together
+		ans = [self runComponentAttacks:components options:options];
+		NSLog(@"%lu Solution(s) took %f msec in %lu independent parts", (unsigned long)[[self getSolutions] count], ([NSDate timeIntervalSinceReferenceDate] - begin) * 1000, (unsigned long)[components count]);
+	} else if ((options & QuipAttackParallel) == 0) {
+		// ...now run through the block attack on this thread
+		QUIP_STAT_ADD(legendCopies, 1);
+		ans = [self runWordBlockAttackFromIndex:0 withLegend:[[self getStartingLegend] copy] options:options];
+		NSLog(@"%lu Solution(s) took %f msec", (unsigned long)[[self getSolutions] count], ([NSDate timeIntervalSinceReferenceDate] - begin) * 1000);
+	} else {
+		/*
+		 Split the tree into the legends at the first level or two. We want
+		 a good number of tasks per worker so that the stealing can even out
+		 the load, but we never split the last word - that's where we decode.
+		 */
+		WorkPool*	pool = [WorkPool sharedWorkPool];
+		NSUInteger	wanted = [pool getWorkerCount] * PARALLEL_TASKS_PER_WORKER;
+		NSArray*	roots = [NSArray arrayWithObject:[self getStartingLegend]];
+		NSUInteger	depth = 0;
+		while ((depth < PARALLEL_MAX_SPLIT_DEPTH) && (depth < count - 1) && ([roots count] < wanted)) {
+			NSMutableArray*	next = [NSMutableArray array];
+			for (Legend* key in roots) {
+				[next addObjectsFromArray:[self expandLegend:key onIndex:depth]];
+			}
+			roots = next;
+			++depth;
+		}
+
+		// make a task for each - the one that hits the limit stops the rest
+		NSMutableArray*	tasks = [NSMutableArray arrayWithCapacity:[roots count]];
+		for (Legend* key in roots) {
+			[tasks addObject:[^{
+				if (![self isCancelled]) {
+					[self runWordBlockAttackFromIndex:depth withLegend:key options:options];
+				}
+			} copy]];
+		}
+		[pool runTasksAndWait:tasks];
+
+		ans = ([[self getSolutions] count] > 0);
+		NSLog(@"%lu Solution(s) took %f msec on %lu workers with %lu tasks", (unsigned long)[[self getSolutions] count], ([NSDate timeIntervalSinceReferenceDate] - begin) * 1000, (unsigned long)[pool getWorkerCount], (unsigned long)[tasks count]);
+	}
+
+	// ...and don't hang onto the caller's block
+	_searchTime = [NSDate timeIntervalSinceReferenceDate] - begin;
+	[self setSolutionHandler:nil];
+
 	return ans;
 }
 
+
+/*!
+ This method tells the attack that's running to stop as soon as it can. It
+ can be called from any thread, and the attack will check for it at every
+ word it tries, so it won't be long.
+ */
+- (void) cancelAttack
+{
+	[self setCancelled:YES];
+	// ...and if it's in parts, each of them has to stop as well
+	@synchronized(self) {
+		for (Quip* part in _componentQuips) {
+			[part cancelAttack];
+		}
+	}
+}
+
 @end
@@ -0,0 +1,514 @@
+//
+//  QuipDict.c
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/2/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// System Headers
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Other Headers
+#include "QuipDict.h"
+
+// Private Data Types
+typedef struct {
+	const char*		word;
+	const char*		pattern;
+	uint32_t		length;
+} QDEntry;
+
+// Private Constants
+#define FNV_OFFSET		0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
+
+// Private Macros
+#define HEADER_CHECKED_BYTES	offsetof(QDHeader, headerChecksum)
+
+
+/*
+ * This function computes the uniform pattern of the word - exactly like
+ * +[CypherWord createPatternText:] - into the provided buffer, which has to
+ * be at least len+1 bytes. The word is treated case-insensitively.
+ */
+void qd_pattern(const char* word, size_t len, char* pattern)
+{
+	for (size_t i = 0; i < len; ++i) {
+		int		c = tolower((unsigned char)word[i]);
+		size_t	j = 0;
+		while (tolower((unsigned char)word[j]) != c) {
+			++j;
+		}
+		pattern[i] = (char)('a' + j);
+	}
+	pattern[len] = '\0';
+}
+
+
+/*
+ * This function computes the 64-bit FNV-1a checksum of the bytes. It's not
+ * cryptographic, but it'll catch truncated and scribbled-on images.
+ */
+uint64_t qd_checksum(const void* data, size_t len)
+{
+	const uint8_t*	p = (const uint8_t*)data;
+	uint64_t		hash = FNV_OFFSET;
+	for (size_t i = 0; i < len; ++i) {
+		hash = (hash ^ p[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+
+/*
+ * This is the ordering of the entries in the image - by length, then by
+ * pattern, and then by the word itself so that duplicates end up together.
+ */
+static int compareEntries(const void* a, const void* b)
+{
+	const QDEntry*	me = (const QDEntry*)a;
+	const QDEntry*	him = (const QDEntry*)b;
+	if (me->length != him->length) {
+		return (me->length < him->length ? -1 : 1);
+	}
+	int		diff = strcmp(me->pattern, him->pattern);
+	return (diff != 0 ? diff : strcmp(me->word, him->word));
+}
+
+
+/*
+ * This function builds a complete image from the newline-separated list of
+ * words in 'text'. The words are lowercased, de-duplicated and grouped by
+ * length and pattern. The image is malloc'd and returned in '*image' with
+ * its size in '*size' - the caller needs to free() it. The source size and
+ * modification time are simply recorded in the header. Returns 0 on success.
+ */
+int qd_build_image(const char* text, size_t len, uint64_t sourceSize, int64_t sourceMTime, void** image, size_t* size)
+{
+	int			error = 0;
+	char*		scratch = NULL;
+	QDEntry*	ents = NULL;
+	size_t		entCnt = 0;
+	uint8_t*	img = NULL;
+
+	if ((text == NULL) || (image == NULL) || (size == NULL)) {
+		return EINVAL;
+	}
+
+	/*
+	 * Every word, and its pattern, goes into the scratch space as a pair
+	 * of NUL-terminated strings - that's never more than twice the text
+	 * plus the terminators, and there can't be more words than lines.
+	 */
+	size_t		lines = 1;
+	for (size_t i = 0; i < len; ++i) {
+		if (text[i] == '\n') {
+			++lines;
+		}
+	}
+	scratch = (char*)malloc(2 * len + 2 * lines + 2);
+	ents = (QDEntry*)malloc(lines * sizeof(QDEntry));
+	if ((scratch == NULL) || (ents == NULL)) {
+		error = ENOMEM;
+	}
+
+	// break up the text into the lowercase words and their patterns
+	if (!error) {
+		char*		dst = scratch;
+		size_t		i = 0;
+		while (i < len) {
+			size_t	beg = i;
+			while ((i < len) && (text[i] != '\n')) {
+				++i;
+			}
+			size_t	end = i++;
+			// trim off any whitespace - like a DOS line ending
+			while ((beg < end) && isspace((unsigned char)text[beg])) {
+				++beg;
+			}
+			while ((end > beg) && isspace((unsigned char)text[end - 1])) {
+				--end;
+			}
+			size_t	wlen = end - beg;
+			if ((wlen == 0) || (wlen > QD_MAX_WORD_LEN)) {
+				continue;
+			}
+			QDEntry*	e = &ents[entCnt++];
+			e->length = (uint32_t)wlen;
+			e->word = dst;
+			for (size_t j = 0; j < wlen; ++j) {
+				*dst++ = (char)tolower((unsigned char)text[beg + j]);
+			}
+			*dst++ = '\0';
+			e->pattern = dst;
+			qd_pattern(e->word, wlen, dst);
+			dst += wlen + 1;
+		}
+	}
+
+	// sort them so the buckets are contiguous and the duplicates adjacent
+	if (!error) {
+		qsort(ents, entCnt, sizeof(QDEntry), compareEntries);
+		size_t	uniq = 0;
+		for (size_t i = 0; i < entCnt; ++i) {
+			if ((uniq == 0) || (strcmp(ents[uniq - 1].word, ents[i].word) != 0)) {
+				ents[uniq++] = ents[i];
+			}
+		}
+		entCnt = uniq;
+	}
+
+	// now we can size up the image and lay it all out
+	size_t		bucketCnt = 0;
+	size_t		arenaSize = 0;
+	uint32_t	maxLen = 0;
+	if (!error) {
+		for (size_t i = 0; i < entCnt; ++i) {
+			arenaSize += ents[i].length + 1;
+			if ((i == 0) || (ents[i - 1].length != ents[i].length) ||
+				(strcmp(ents[i - 1].pattern, ents[i].pattern) != 0)) {
+				++bucketCnt;
+				arenaSize += ents[i].length + 1;
+			}
+			if (ents[i].length > maxLen) {
+				maxLen = ents[i].length;
+			}
+		}
+		if (arenaSize > UINT32_MAX) {
+			error = EFBIG;
+		}
+	}
+
+	size_t		bucketsOff = (sizeof(QDHeader) + 7) & ~(size_t)7;
+	size_t		wordsOff = bucketsOff + bucketCnt * sizeof(QDBucket);
+	size_t		arenaOff = wordsOff + entCnt * sizeof(uint32_t);
+	size_t		total = (arenaOff + arenaSize + 7) & ~(size_t)7;
+	if (!error) {
+		if ((img = (uint8_t*)calloc(1, total)) == NULL) {
+			error = ENOMEM;
+		}
+	}
+
+	if (!error) {
+		QDHeader*	hdr = (QDHeader*)img;
+		QDBucket*	buckets = (QDBucket*)(img + bucketsOff);
+		uint32_t*	words = (uint32_t*)(img + wordsOff);
+		char*		arena = (char*)(img + arenaOff);
+
+		// the words go first in the arena...
+		uint32_t	at = 0;
+		for (size_t i = 0; i < entCnt; ++i) {
+			words[i] = at;
+			memcpy(arena + at, ents[i].word, ents[i].length + 1);
+			at += ents[i].length + 1;
+		}
+		// ...and then the patterns, one per bucket
+		QDBucket*	b = NULL;
+		for (size_t i = 0; i < entCnt; ++i) {
+			if ((b == NULL) || (b->length != ents[i].length) ||
+				(strcmp(arena + b->pattern, ents[i].pattern) != 0)) {
+				b = (b == NULL ? buckets : b + 1);
+				b->pattern = at;
+				b->length = ents[i].length;
+				b->first = (uint32_t)i;
+				b->count = 0;
+				memcpy(arena + at, ents[i].pattern, ents[i].length + 1);
+				at += ents[i].length + 1;
+			}
+			++b->count;
+		}
+
+		// fill in the header, and checksum it all
+		memcpy(hdr->magic, QD_MAGIC, sizeof(hdr->magic));
+		hdr->version = QD_VERSION;
+		hdr->headerSize = (uint32_t)sizeof(QDHeader);
+		hdr->fileSize = total;
+		hdr->sourceSize = sourceSize;
+		hdr->sourceMTime = sourceMTime;
+		hdr->wordCount = (uint32_t)entCnt;
+		hdr->bucketCount = (uint32_t)bucketCnt;
+		hdr->arenaSize = (uint32_t)arenaSize;
+		hdr->maxWordLength = maxLen;
+		hdr->bucketsOffset = bucketsOff;
+		hdr->wordsOffset = wordsOff;
+		hdr->arenaOffset = arenaOff;
+		hdr->payloadChecksum = qd_checksum(img + bucketsOff, total - bucketsOff);
+		hdr->headerChecksum = qd_checksum(hdr, HEADER_CHECKED_BYTES);
+
+		*image = img;
+		*size = total;
+		img = NULL;
+	}
+
+	free(img);
+	free(ents);
+	free(scratch);
+	return error;
+}
+
+
+/*
+ * This function reads the word list at 'srcPath', builds the image, and
+ * writes it to 'dstPath'. It writes to a temp file and renames it into
+ * place so that anyone mapping the old one isn't hurt. Returns 0 on success.
+ */
+int qd_build_file(const char* srcPath, const char* dstPath)
+{
+	int			error = 0;
+	int			fd = -1;
+	char*		text = NULL;
+	void*		img = NULL;
+	size_t		imgSize = 0;
+	struct stat	st;
+
+	// read in the complete source word list
+	if ((fd = open(srcPath, O_RDONLY)) < 0) {
+		error = errno;
+	} else if (fstat(fd, &st) != 0) {
+		error = errno;
+	} else if ((text = (char*)malloc((size_t)st.st_size + 1)) == NULL) {
+		error = ENOMEM;
+	} else {
+		size_t	got = 0;
+		while (!error && (got < (size_t)st.st_size)) {
+			ssize_t	n = read(fd, text + got, (size_t)st.st_size - got);
+			if (n < 0) {
+				if (errno != EINTR) {
+					error = errno;
+				}
+			} else if (n == 0) {
+				error = EIO;
+			} else {
+				got += (size_t)n;
+			}
+		}
+	}
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+
+	// build the image in memory...
+	if (!error) {
+		error = qd_build_image(text, (size_t)st.st_size, (uint64_t)st.st_size, (int64_t)st.st_mtime, &img, &imgSize);
+	}
+
+	// ...and write it out to a temp file, and then move it into place
+	if (!error) {
+		size_t	tmpLen = strlen(dstPath) + 8;
+		char	tmpPath[tmpLen];
+		snprintf(tmpPath, tmpLen, "%s.XXXXXX", dstPath);
+		if ((fd = mkstemp(tmpPath)) < 0) {
+			error = errno;
+		} else {
+			size_t	put = 0;
+			while (!error && (put < imgSize)) {
+				ssize_t	n = write(fd, (uint8_t*)img + put, imgSize - put);
+				if (n < 0) {
+					if (errno != EINTR) {
+						error = errno;
+					}
+				} else {
+					put += (size_t)n;
+				}
+			}
+			if (!error && (fchmod(fd, 0644) != 0)) {
+				error = errno;
+			}
+			if ((close(fd) != 0) && !error) {
+				error = errno;
+			}
+			if (!error && (rename(tmpPath, dstPath) != 0)) {
+				error = errno;
+			}
+			if (error) {
+				unlink(tmpPath);
+			}
+		}
+	}
+
+	free(img);
+	free(text);
+	return error;
+}
+
+
+/*
+ * This function checks the header of the image - that it's ours, it's the
+ * right version, and all the offsets are where they could possibly be.
+ */
+static int checkHeader(const uint8_t* base, size_t size)
+{
+	const QDHeader*	hdr = (const QDHeader*)base;
+	if ((size < sizeof(QDHeader)) ||
+		(memcmp(hdr->magic, QD_MAGIC, sizeof(hdr->magic)) != 0) ||
+		(hdr->version != QD_VERSION) ||
+		(hdr->headerSize != sizeof(QDHeader)) ||
+		(hdr->fileSize != size) ||
+		(hdr->headerChecksum != qd_checksum(hdr, HEADER_CHECKED_BYTES))) {
+		return EINVAL;
+	}
+	if ((hdr->bucketsOffset + (uint64_t)hdr->bucketCount * sizeof(QDBucket) > hdr->wordsOffset) ||
+		(hdr->wordsOffset + (uint64_t)hdr->wordCount * sizeof(uint32_t) > hdr->arenaOffset) ||
+		(hdr->arenaOffset + hdr->arenaSize > size)) {
+		return EINVAL;
+	}
+	return 0;
+}
+
+
+/*
+ * This function fills in all the pointers into the image once we know that
+ * it's a good one.
+ */
+static void wireImage(QDImage* img, const uint8_t* base, size_t size, int mapped)
+{
+	img->base = base;
+	img->size = size;
+	img->mapped = mapped;
+	img->header = (const QDHeader*)base;
+	img->buckets = (const QDBucket*)(base + img->header->bucketsOffset);
+	img->words = (const uint32_t*)(base + img->header->wordsOffset);
+	img->arena = (const char*)(base + img->header->arenaOffset);
+}
+
+
+/*
+ * This function returns 1 if the image at 'dictPath' exists, is valid, and
+ * was built from the word list at 'srcPath' as it is now - based on the size
+ * and modification time of the source. Otherwise, it returns 0.
+ */
+int qd_is_current(const char* dictPath, const char* srcPath)
+{
+	int			current = 0;
+	struct stat	st;
+	QDImage		img;
+	if ((stat(srcPath, &st) == 0) && (qd_open(&img, dictPath) == 0)) {
+		current = ((img.header->sourceSize == (uint64_t)st.st_size) &&
+				   (img.header->sourceMTime == (int64_t)st.st_mtime));
+		qd_close(&img);
+	}
+	return current;
+}
+
+
+/*
+ * This function mmaps the image at 'path' read-only and shared, and checks
+ * the header - but not the payload, so it's constant time. Returns 0 on
+ * success, and the image needs to be closed with qd_close().
+ */
+int qd_open(QDImage* img, const char* path)
+{
+	int			error = 0;
+	int			fd = -1;
+	struct stat	st;
+	void*		base = MAP_FAILED;
+
+	memset(img, 0, sizeof(QDImage));
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		error = errno;
+	} else if (fstat(fd, &st) != 0) {
+		error = errno;
+	} else if ((size_t)st.st_size < sizeof(QDHeader)) {
+		error = EINVAL;
+	} else if ((base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		error = errno;
+	} else if ((error = checkHeader((const uint8_t*)base, (size_t)st.st_size)) != 0) {
+		munmap(base, (size_t)st.st_size);
+	} else {
+		wireImage(img, (const uint8_t*)base, (size_t)st.st_size, 1);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	return error;
+}
+
+
+/*
+ * This function wraps an image that's already in memory - like one from
+ * qd_build_image() - and takes ownership of it, freeing it in qd_close().
+ * Returns 0 on success.
+ */
+int qd_attach(QDImage* img, void* image, size_t size)
+{
+	int		error = 0;
+	memset(img, 0, sizeof(QDImage));
+	if ((image == NULL) || ((error = checkHeader((const uint8_t*)image, size)) != 0)) {
+		error = EINVAL;
+	} else {
+		wireImage(img, (const uint8_t*)image, size, 0);
+	}
+	return error;
+}
+
+
+/*
+ * This function checks the payload checksum of the image. It's a complete
+ * pass over the data, so it's not something to do on every open.
+ */
+int qd_verify(const QDImage* img)
+{
+	if ((img == NULL) || (img->header == NULL)) {
+		return EINVAL;
+	}
+	uint64_t	off = img->header->bucketsOffset;
+	uint64_t	sum = qd_checksum(img->base + off, img->size - off);
+	return (sum == img->header->payloadChecksum ? 0 : EINVAL);
+}
+
+
+/*
+ * This function unmaps, or frees, the image and clears the structure.
+ */
+void qd_close(QDImage* img)
+{
+	if ((img != NULL) && (img->base != NULL)) {
+		if (img->mapped) {
+			munmap((void*)img->base, img->size);
+		} else {
+			free((void*)img->base);
+		}
+		memset(img, 0, sizeof(QDImage));
+	}
+}
+
+
+/*
+ * This function finds the bucket of words with the given pattern and returns
+ * it, or NULL if there are no words with that pattern.
+ */
+const QDBucket* qd_find_bucket(const QDImage* img, const char* pattern, size_t len)
+{
+	const QDBucket*	found = NULL;
+	if ((img != NULL) && (img->header != NULL) && (pattern != NULL)) {
+		size_t	lo = 0;
+		size_t	hi = img->header->bucketCount;
+		while (lo < hi) {
+			size_t			mid = lo + (hi - lo) / 2;
+			const QDBucket*	b = &img->buckets[mid];
+			int				diff = (b->length == len ? 0 : (b->length < len ? -1 : 1));
+			if (diff == 0) {
+				diff = strncmp(img->arena + b->pattern, pattern, len);
+			}
+			if (diff == 0) {
+				found = b;
+				break;
+			} else if (diff < 0) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+	}
+	return found;
+}
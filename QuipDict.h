@@ -0,0 +1,164 @@
+//
+//  QuipDict.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/2/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+#ifndef __QUIPDICT_H
+#define __QUIPDICT_H
+
+// System Headers
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * This is the compiled, binary, form of the list of plaintext words. The
+ * idea is that the words file is processed once - at build time, or the
+ * first time it's seen - into an image that can simply be mmap'd and used
+ * as-is. No parsing, no allocating 25k strings, and since it's mapped
+ * read-only and shared, every process using it shares the same pages.
+ *
+ * The layout of the image is:
+ *
+ *   QDHeader        - the magic, version, counts, offsets and checksums
+ *   QDBucket[]      - one per (length, pattern), sorted by length then
+ *                     pattern, so a lookup is a binary search
+ *   uint32_t[]      - the arena offset of each word, grouped by bucket, so
+ *                     the words of a bucket are a contiguous run of ids
+ *   char[]          - the arena of NUL-terminated lowercase words, and
+ *                     after them, the NUL-terminated bucket patterns
+ *
+ * All values are in the byte order of the machine that built the image,
+ * and the magic is checked to make sure we aren't reading a foreign one.
+ */
+
+// Public Constants
+#define QD_MAGIC			"QUIPDICT"
+#define QD_VERSION			1
+#define QD_MAX_WORD_LEN		64
+
+// Public Data Types
+typedef struct {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	headerSize;
+	uint64_t	fileSize;
+	// where the words came from - so we know when to rebuild
+	uint64_t	sourceSize;
+	int64_t		sourceMTime;
+	// what's in the image
+	uint32_t	wordCount;
+	uint32_t	bucketCount;
+	uint32_t	arenaSize;
+	uint32_t	maxWordLength;
+	uint64_t	bucketsOffset;
+	uint64_t	wordsOffset;
+	uint64_t	arenaOffset;
+	// FNV-1a checksums of everything after the header, and the header
+	uint64_t	payloadChecksum;
+	uint64_t	headerChecksum;
+} QDHeader;
+
+typedef struct {
+	uint32_t	pattern;		// arena offset of the pattern string
+	uint32_t	length;			// length of every word in the bucket
+	uint32_t	first;			// id of the first word in the bucket
+	uint32_t	count;			// number of words in the bucket
+} QDBucket;
+
+typedef struct {
+	const uint8_t*		base;
+	size_t				size;
+	int					mapped;
+	const QDHeader*		header;
+	const QDBucket*		buckets;
+	const uint32_t*		words;
+	const char*			arena;
+} QDImage;
+
+/*
+ * This function computes the uniform pattern of the word - exactly like
+ * +[CypherWord createPatternText:] - into the provided buffer, which has to
+ * be at least len+1 bytes. The word is treated case-insensitively.
+ */
+void qd_pattern(const char* word, size_t len, char* pattern);
+
+/*
+ * This function computes the 64-bit FNV-1a checksum of the bytes. It's not
+ * cryptographic, but it'll catch truncated and scribbled-on images.
+ */
+uint64_t qd_checksum(const void* data, size_t len);
+
+/*
+ * This function builds a complete image from the newline-separated list of
+ * words in 'text'. The words are lowercased, de-duplicated and grouped by
+ * length and pattern. The image is malloc'd and returned in '*image' with
+ * its size in '*size' - the caller needs to free() it. The source size and
+ * modification time are simply recorded in the header. Returns 0 on success.
+ */
+int qd_build_image(const char* text, size_t len, uint64_t sourceSize, int64_t sourceMTime, void** image, size_t* size);
+
+/*
+ * This function reads the word list at 'srcPath', builds the image, and
+ * writes it to 'dstPath'. It writes to a temp file and renames it into
+ * place so that anyone mapping the old one isn't hurt. Returns 0 on success.
+ */
+int qd_build_file(const char* srcPath, const char* dstPath);
+
+/*
+ * This function returns 1 if the image at 'dictPath' exists, is valid, and
+ * was built from the word list at 'srcPath' as it is now - based on the size
+ * and modification time of the source. Otherwise, it returns 0.
+ */
+int qd_is_current(const char* dictPath, const char* srcPath);
+
+/*
+ * This function mmaps the image at 'path' read-only and shared, and checks
+ * the header - but not the payload, so it's constant time. Returns 0 on
+ * success, and the image needs to be closed with qd_close().
+ */
+int qd_open(QDImage* img, const char* path);
+
+/*
+ * This function wraps an image that's already in memory - like one from
+ * qd_build_image() - and takes ownership of it, freeing it in qd_close().
+ * Returns 0 on success.
+ */
+int qd_attach(QDImage* img, void* image, size_t size);
+
+/*
+ * This function checks the payload checksum of the image. It's a complete
+ * pass over the data, so it's not something to do on every open.
+ */
+int qd_verify(const QDImage* img);
+
+/*
+ * This function unmaps, or frees, the image and clears the structure.
+ */
+void qd_close(QDImage* img);
+
+/*
+ * This function finds the bucket of words with the given pattern and returns
+ * it, or NULL if there are no words with that pattern.
+ */
+const QDBucket* qd_find_bucket(const QDImage* img, const char* pattern, size_t len);
+
+/*
+ * This function returns the NUL-terminated word with the given id.
+ */
+static inline const char* qd_word(const QDImage* img, uint32_t wid)
+{
+	return img->arena + img->words[wid];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// __QUIPDICT_H
@@ -22,10 +22,73 @@
 // Forward Class Declarations
 
 // Protected Data Types
+/*!
+ This is what the dynamic ordering and the forward checking of the "Word
+ Block" attack keep track of as they go: which pieces have a word already,
+ and for each of the rest, how many of its possibles are still consistent
+ with the legend. With forward checking, the possibles themselves are kept
+ as a mask for each piece, and they are narrowed as the legend grows - with
+ the masks that were narrowed saved on a trail so they can be put back on
+ the way out - and the pieces that share letters with the one that just got
+ its word are narrowed by the rows of their tables, if they have them. The
+ codes and columns of the pieces are here too, so the
+ search doesn't have to go back to the objects for them at every step.
+ */
+typedef struct {
+	QuipAttackOptions	options;		// the ordering and checking to do
+	NSUInteger			count;			// the number of puzzle pieces
+	NSUInteger			assignedCount;	// ...and how many have a word
+	BOOL*				assigned;		// YES if the piece has a word
+	uint32_t*			liveCounts;		// the possibles still consistent
+	uint32_t*			letterMasks;	// the cypher letters in each piece
+	uint32_t*			plainMasks;		// the plaintext letters its possibles use
+	const uint8_t**		cypherCodes;	// the coded cypherword of each
+	const uint8_t**		possibleCodes;	// the coded possibles of each
+	const MKColumns**	columns;		// the columns of those possibles
+	uint64_t*			scratch;		// a mask big enough for any piece
+	uint64_t**			liveMasks;		// forward checking - the possibles left
+	uint64_t*			trail;			// ...the masks saved before narrowing
+	size_t				trailLength;	// ...and how many words are on it
+	NSUInteger*			trailPieces;	// ...the pieces they came from
+	size_t				trailPieceCount;
+	const MKPairTable*	pairTables;		// ...the tables of the pairs, or NULL
+	uint64_t			assignedKey;	// the key of the pieces with words
+} QuipSearchState;
 
 // Protected Constants
 
 // Protected Macros
+/*!
+ These are how the attacks count what they do into the QuipStatistics. With
+ QUIP_INSTRUMENTATION defined, they are atomic, as the parallel attack has
+ many threads counting at once - and without it, they are nothing at all.
+ They need to be used in a method of the Quip, as they use its ivars.
+ */
+#ifdef QUIP_INSTRUMENTATION
+#define QUIP_STAT_ADD(field, n)		__sync_fetch_and_add(&(_statistics.field), (uint64_t)(n))
+#define QUIP_STAT_SUB(field, n)		__sync_fetch_and_sub(&(_statistics.field), (uint64_t)(n))
+#define QUIP_STAT_NODE(depth)		quipStatNode(&_statistics, (depth))
+#else
+#define QUIP_STAT_ADD(field, n)
+#define QUIP_STAT_SUB(field, n)
+#define QUIP_STAT_NODE(depth)
+#endif
+
+#ifdef QUIP_INSTRUMENTATION
+/*!
+ This function counts a node at the depth in the search, and makes sure
+ the deepest depth is at least that deep - even with the other threads
+ doing the same thing.
+ */
+static inline void quipStatNode(QuipStatistics* stats, NSUInteger depth)
+{
+	__sync_fetch_and_add(&stats->nodesAtDepth[(depth < QUIP_STAT_DEPTHS ? depth : QUIP_STAT_DEPTHS - 1)], 1);
+	uint64_t	seen = stats->maxDepth;
+	while ((depth > seen) && !__sync_bool_compare_and_swap(&stats->maxDepth, seen, (uint64_t)depth)) {
+		seen = stats->maxDepth;
+	}
+}
+#endif
 
 
 /*!
@@ -126,22 +189,197 @@
 - (BOOL) removeFromSolutions:(NSString*)plaintext;
 
 /*!
- This method clears out all the solutions from the maintained list. It's
- a good step to call in the -dealloc method, or when you want to start over.
+ This method clears out all the solutions from the maintained list - and
+ their legends. It's a good step to call in the -dealloc method, or when you
+ want to start over.
  */
 - (void) removeAllSolutions;
 
+/*!
+ This method sets the set of legends of the solutions that have been found
+ so far. It's how we make sure that each solution is only counted once.
+
+ @param set The set of Legends of the solutions to the Quip
+ */
+- (void) setSolutionKeys:(NSMutableSet*)set;
+
+/*!
+ This method returns the most solutions the attack that's running is
+ supposed to find - or zero if it's supposed to find all of them.
+
+ @param
+ @return The most solutions to find, or zero for all of them
+ */
+- (NSUInteger) getSolutionLimit;
+
+/*!
+ This method sets the most solutions the next attack is supposed to find
+ - or zero if it's supposed to find all of them. When the limit is hit, the
+ attack is cancelled.
+
+ @param limit The most solutions to find, or zero for all of them
+ */
+- (void) setSolutionLimit:(NSUInteger)limit;
+
+/*!
+ This method returns the block that's called with each solution as it's
+ found by the attack that's running - if there is one.
+
+ @param
+ @return The QuipSolutionHandler for the attack, or nil
+ */
+- (QuipSolutionHandler) getSolutionHandler;
+
+/*!
+ This method sets the block that's to be called with each solution as it's
+ found by the next attack. It can be nil if no one needs to know until the
+ attack is done.
+
+ @param handler The QuipSolutionHandler for the attack, or nil
+ */
+- (void) setSolutionHandler:(QuipSolutionHandler)handler;
+
+/*!
+ This method is what the attacks call when they have a legend that decodes
+ the whole quip. If it's not already a solution - and that's checked by the
+ hash of the legend, so it's quick - the decoding is added to the list of
+ solutions, and a copy of the legend to the set of keys, and the handler
+ is called with them. If that's as many solutions as we're looking for,
+ the attack is cancelled. It's safe to call this from many threads.
+
+ @param legend The Legend that decodes the whole Quip
+ @return YES if this was a new solution, and it was added
+ */
+- (BOOL) addToSolutionsWithLegend:(Legend*)legend;
+
+/*!
+ This method sets the flag that tells the running attack to stop. It's the
+ way the attacks are cancelled - by the caller, or by a parallel attack
+ that has found all the solutions it was looking for.
+
+ @param flag YES if the attack should stop as soon as it can
+ */
+- (void) setCancelled:(BOOL)flag;
+
 //----------------------------------------------------------------------------
 //					Solution Methods
 //----------------------------------------------------------------------------
 
 /*!
- This is the recursive entry point for attempting the "Word Block" attack on
- the cyphertext starting at the 'index'th word in the quip. The idea is that
+ This method gets the puzzle ready for one of the attacks. The pieces are
+ sorted so the one with the fewest possibles is first, the letter codes of
+ all the possibles are made - so the search on many threads doesn't have to
+ - and the cancelled flag is cleared.
+ */
+- (void) prepareForAttack;
+
+/*!
+ This method builds the tables - as described in MatchKernel.h - of which
+ possibles of each puzzle piece can go with which possibles of each of the
+ other pieces it shares a cypher letter with. They are in the order the
+ pieces are in, so this needs to be done after they are sorted, and if
+ they are already built for the pieces in this order, they are kept. The
+ tables are built on the shared WorkPool, and the pairs with tables that
+ would be too big to pay for themselves are left out - the forward checking
+ filters those the old way.
+ */
+- (void) buildPairTables;
+
+/*!
+ This method frees up all the tables of the pairs of puzzle pieces, so
+ that they will be built again the next time they are needed.
+ */
+- (void) freePairTables;
+
+/*!
+ This method returns the table of which possibles of the 'from'th puzzle
+ piece can go with which of the 'to'th, or NULL if there isn't one.
+
+ @param from The zero-biased index of the piece that gets its word
+ @param to The zero-biased index of the piece that's narrowed
+ @return The MKPairTable of the two pieces, or NULL
+ */
+- (const MKPairTable*) getPairTableFrom:(NSUInteger)from to:(NSUInteger)to;
+
+/*!
+ This method gets the table of nogoods ready for an attack - it's made if
+ it's not there, and emptied out if it is - and works out the cypher
+ letters of the puzzle pieces from each one to the end, in the order they
+ are in now, so the search can tell what's left to do at each depth. It
+ needs to be done after the pieces are sorted.
+ */
+- (void) resetNogoodTable;
+
+/*!
+ This method frees up the table of nogoods, and the cypher letters that go
+ with it.
+ */
+- (void) freeNogoodTable;
+
+/*!
+ This method splits the puzzle pieces into the groups that are connected
+ by the cypher letters that aren't in the starting legend - two pieces are
+ in the same group if they share one of those, or are both in a group with
+ a third. The groups have nothing to say about each other's words, save
+ that they can't use the same plaintext letters, so each can be solved on
+ its own. The pieces stay in the order they are in now.
+
+ @param
+ @return The array of the groups, each an array of PuzzlePieces
+ */
+- (NSArray*) getComponents;
+
+/*!
+ This method solves each of the groups of puzzle pieces from -getComponents
+ as a Quip of its own - all at once, on the shared WorkPool - and then puts
+ the legends of those solutions together, one from each group, to make the
+ solutions of the whole quip. Only the legends that don't give the same
+ plaintext letter to cypher letters in two groups go together.
+
+ With a limit, the groups are solved lazily: first for one solution each,
+ and then, if putting them together comes up short of the limit, the ones
+ that might have more are solved again for twice as many, until there are
+ enough, or every group has given up all it has. Without a limit, each is
+ solved for all of its solutions at once. It stops as soon as it has the
+ limit of solutions, or if one of the groups has none.
+
+ The statistics of the groups are added into this quip's, but the depths
+ - the nodes at each depth, and the deepest - are the depths within each
+ group, not in the whole quip.
+
+ @param components The array of the groups of PuzzlePieces to solve
+ @param options The QuipAttackOptions for the attack on each group
+ @return YES if the attack on the puzzle was successful
+ */
+- (BOOL) runComponentAttacks:(NSArray*)components options:(QuipAttackOptions)options;
+
+/*!
+ This is the recursive part of putting the solutions of the groups back
+ together. The legend has one solution from each of the groups before the
+ 'index'th, and each of the legends of the 'index'th group is added to it
+ in turn - if it doesn't give away a plaintext letter that's already been
+ given away - and then the rest of the groups are added, until they are all
+ there, and it's a solution to the whole quip. The legend is just as it was
+ passed in when this returns.
+
+ @param legends The array of the arrays of Legends of each group's solutions
+ @param index The zero-biased index of the group to add to the legend
+ @param legend The Legend (key) with the groups before the index in it
+ */
+- (void) combineComponentLegends:(NSArray*)legends fromIndex:(NSUInteger)index withLegend:(Legend*)legend;
+
+/*!
+ This is the entry point for attempting the "Word Block" attack on the
+ cyphertext starting at the 'index'th word in the quip. The idea is that
  we start with the provided legend, and then for each plaintext word in the
  'index'ed cypherword that matches the legend, we add those keys not in
  the legend, but supplied by the plaintext to the legend, and then try the
  next cypherword in the same manner.
+
+ This gets the levels of the letters that are already in the legend ready
+ for the backjumping, and starts the recursion. The letters of the hint
+ can't be undone, and the rest were added before the 'index'th word, so
+ they are put down to the word just before it.
  
  If this attack results in a successful decoding of the cyphertext, this method
  will return YES, otherwise, it will return NO.
@@ -152,4 +390,104 @@
  */
 - (BOOL) doWordBlockAttackOnIndex:(NSUInteger)index withLegend:(Legend*)legend;
 
+/*!
+ This is the recursive part of the "Word Block" attack - each possible of
+ the 'index'th piece that fits the legend is added to it, and the next
+ piece is tried with that, until the last piece decodes the whole quip.
+
+ The legend is used for every guess at every level - it's added to on the
+ way down, and rolled back on the way up - so it's not copied, and it's
+ just as it was passed in when this returns.
+
+ This search backjumps. 'levels' has, for each cypher letter in the legend,
+ the index of the piece whose word mapped it - or MK_NO_LEVEL for the hint
+ - and when a piece runs out of words, the levels whose letters ruled them
+ out are returned in 'conflicts', as a mask with bit n for the nth piece.
+ If this piece isn't in the conflicts of the piece after it, then no other
+ word here can help, so there's no point in trying the rest of them - this
+ returns right away, with those conflicts, and so on up to the deepest
+ piece that's in them. If 'levels' is NULL, there are too many pieces for
+ the mask, and every failure is put down to every level before it.
+
+ @param index The zero-biased index of PuzzlePieces to continue the attack on
+ @param key The Legend (key) to continue the attack with
+ @param levels The 26 element array of the levels that mapped each letter, or NULL
+ @param conflicts The levels that are to blame if this returns NO
+ @return YES if the attack on the puzzle was successful
+ */
+- (BOOL) doWordBlockAttackOnIndex:(NSUInteger)index withLegend:(Legend*)key levels:(uint8_t*)levels conflicts:(uint64_t*)conflicts;
+
+/*!
+ This method returns all the legends that come from extending the provided
+ legend with each of the possible plaintexts of the 'index'th puzzle piece
+ that it can match. These are the roots of the subtrees of the search that
+ the parallel attack hands out as tasks.
+
+ @param legend The Legend (key) to extend
+ @param index The zero-biased index of the PuzzlePiece to extend it with
+ @return The array of all the consistent, extended, Legends
+ */
+- (NSArray*) expandLegend:(Legend*)legend onIndex:(NSUInteger)index;
+
+/*!
+ This method runs the "Word Block" attack from the 'index'th puzzle piece
+ with the provided legend - the pieces before it are assumed to already be
+ in the legend. The options say which order the rest of the pieces are to
+ be tried in: as they are sorted, or the most constrained one at each step,
+ and whether the possibles of the other pieces are to be forward checked.
+
+ @param index The zero-biased index of PuzzlePieces to start the attack on
+ @param legend The Legend (key) to start the attack with
+ @param options The QuipAttackOptions for this attack
+ @return YES if the attack on the puzzle was successful
+ */
+- (BOOL) runWordBlockAttackFromIndex:(NSUInteger)index withLegend:(Legend*)legend options:(QuipAttackOptions)options;
+
+/*!
+ This method fills in the search state for the dynamic ordering and the
+ forward checking of the "Word Block" attack. The pieces before the
+ 'index'th are marked as having a word already, and the rest have their
+ possibles filtered and counted against the legend. If the state can't be
+ made, or one of the pieces has nothing left that's consistent with the
+ legend, this returns NO - but the state still needs to be freed with
+ -freeSearchState:.
+
+ @param state The QuipSearchState to fill in
+ @param index The zero-biased index of the first piece without a word
+ @param legend The Legend (key) to start the attack with
+ @param options The QuipAttackOptions for this attack
+ @return YES if the search has somewhere to go from here
+ */
+- (BOOL) createSearchState:(QuipSearchState*)state fromIndex:(NSUInteger)index withLegend:(Legend*)legend options:(QuipAttackOptions)options;
+
+/*!
+ This method frees up everything in the search state, and clears it out
+ so that it's safe to free it again.
+
+ @param state The QuipSearchState to free
+ */
+- (void) freeSearchState:(QuipSearchState*)state;
+
+/*!
+ This is the recursive entry point for the dynamic ordering and forward
+ checking of the "Word Block" attack. With the dynamic ordering, rather
+ than take the pieces in the order they're sorted in, at each step this
+ picks the piece without a word that has the fewest possibles still
+ consistent with the legend. With forward checking, each word that's added
+ to the legend narrows the possibles of the other pieces, so they don't
+ have to be filtered again when their turn comes. Either way, only the
+ pieces that have a cypher letter that was just added to the legend, or a
+ possible that needs a plaintext letter that was just taken, are looked
+ at - the rest can't have changed - and if any of them goes to zero,
+ there's no point in going any deeper.
+
+ The legend and the state are both just as they were passed in when this
+ returns.
+
+ @param legend The Legend (key) to continue the attack with
+ @param state The QuipSearchState of the search so far
+ @return YES if the attack on the puzzle was successful
+ */
+- (BOOL) doDynamicWordBlockAttackWithLegend:(Legend*)legend state:(QuipSearchState*)state;
+
 @end
@@ -9,6 +9,8 @@
 // Apple Headers
 
 // System Headers
+#include <stdlib.h>
+#include <string.h>
 
 // Third Party Headers
 
@@ -16,6 +18,7 @@
 
 // Class Headers
 #import "Quip_Protected.h"
+#import "WorkPool.h"
 
 // Superclass Headers
 
@@ -24,8 +27,35 @@
 // Private Data Types
 
 // Private Constants
+/*!
+ These are the most uint64_t words that the table of one pair of puzzle
+ pieces can have, and that all of them together can have. Past that, the
+ table takes longer to build, and costs more cache misses to use, than the
+ filter it saves - so the pair is just filtered.
+ */
+#define PAIR_TABLE_MAX_WORDS		(1 << 16)
+#define PAIR_TABLE_TOTAL_WORDS		(1 << 22)
+
+/*!
+ This is the number of places in the search the table of nogoods holds -
+ at 8 bytes each, it's small enough to clear for every attack, and still
+ big enough to hold the dead ends of all but the biggest searches.
+ */
+#define NOGOOD_TABLE_PLACES			(1 << 16)
+
+/*!
+ This is the most puzzle pieces the backjumping can keep track of - the
+ levels to blame are a mask, with a bit for each piece.
+ */
+#define QUIP_MAX_BACKJUMP_LEVELS	64
 
 // Private Macros
+/*!
+ This is what each puzzle piece adds to the key of the pieces that have
+ their words in the dynamic search - they're XOR'ed together, so it's the
+ same no matter the order they got them in.
+ */
+#define NOGOOD_PIECE_KEY(i)			(((uint64_t)(i) + 1) * 0x9e3779b97f4a7c15ULL)
 
 
 /*!
@@ -205,9 +235,11 @@
 			error = YES;
 			NSLog(@"[Quip (Protected) -addToSolutions:] - the master storage of all solutions has not been created. This means that the -init method has probably not been called. Please make sure to properly initialize this object before using it.");
 		} else {
-			// add him if things are OK to this point
-			if (![[self getSolutions] containsObject:plaintext]) {
-				[[self getSolutions] addObject:plaintext];
+			// add him if things are OK to this point - the workers share this
+			@synchronized([self getSolutions]) {
+				if (![[self getSolutions] containsObject:plaintext]) {
+					[[self getSolutions] addObject:plaintext];
+				}
 			}
 		}
 	}
@@ -243,7 +275,9 @@
 			NSLog(@"[Quip (Protected) -removeFromSolutions:] - the master storage of all solutions has not been created. This means that the -init method has probably not been called. Please make sure to properly initialize this object before using it.");
 		} else {
 			// yank him if things are OK to this point
-			[[self getSolutions] removeObject:plaintext];
+			@synchronized([self getSolutions]) {
+				[[self getSolutions] removeObject:plaintext];
+			}
 		}
 	}
 	
@@ -252,8 +286,9 @@
 
 
 /*!
- This method clears out all the solutions from the maintained list. It's
- a good step to call in the -dealloc method, or when you want to start over.
+ This method clears out all the solutions from the maintained list - and
+ their legends. It's a good step to call in the -dealloc method, or when you
+ want to start over.
  */
 - (void) removeAllSolutions
 {
@@ -261,8 +296,157 @@
 		NSLog(@"[Quip (Protected) -removeAllSolutions] - the master storage of all solutions has not been created. This means that the -init method has probably not been called. Please make sure to properly initialize this object before using it.");
 	} else {
 		// clear them all out if things are OK to this point
-		[[self getSolutions] removeAllObjects];
+		@synchronized([self getSolutions]) {
+			[[self getSolutions] removeAllObjects];
+			[[self getSolutionKeys] removeAllObjects];
+		}
+	}
+}
+
+
+/*!
+ This method sets the set of legends of the solutions that have been found
+ so far. It's how we make sure that each solution is only counted once.
+
+ @param set The set of Legends of the solutions to the Quip
+ */
+- (void) setSolutionKeys:(NSMutableSet*)set
+{
+	_solutionKeys = set;
+}
+
+
+/*!
+ This method returns the most solutions the attack that's running is
+ supposed to find - or zero if it's supposed to find all of them.
+
+ @param
+ @return The most solutions to find, or zero for all of them
+ */
+- (NSUInteger) getSolutionLimit
+{
+	return _solutionLimit;
+}
+
+
+/*!
+ This method sets the most solutions the next attack is supposed to find
+ - or zero if it's supposed to find all of them. When the limit is hit, the
+ attack is cancelled.
+
+ @param limit The most solutions to find, or zero for all of them
+ */
+- (void) setSolutionLimit:(NSUInteger)limit
+{
+	_solutionLimit = limit;
+}
+
+
+/*!
+ This method returns the block that's called with each solution as it's
+ found by the attack that's running - if there is one.
+
+ @param
+ @return The QuipSolutionHandler for the attack, or nil
+ */
+- (QuipSolutionHandler) getSolutionHandler
+{
+	return _solutionHandler;
+}
+
+
+/*!
+ This method sets the block that's to be called with each solution as it's
+ found by the next attack. It can be nil if no one needs to know until the
+ attack is done.
+
+ @param handler The QuipSolutionHandler for the attack, or nil
+ */
+- (void) setSolutionHandler:(QuipSolutionHandler)handler
+{
+	_solutionHandler = [handler copy];
+}
+
+
+/*!
+ This method is what the attacks call when they have a legend that decodes
+ the whole quip. If it's not already a solution - and that's checked by the
+ hash of the legend, so it's quick - the decoding is added to the list of
+ solutions, and a copy of the legend to the set of keys, and the handler
+ is called with them. If that's as many solutions as we're looking for,
+ the attack is cancelled. It's safe to call this from many threads.
+
+ @param legend The Legend that decodes the whole Quip
+ @return YES if this was a new solution, and it was added
+ */
+- (BOOL) addToSolutionsWithLegend:(Legend*)legend
+{
+	BOOL			error = NO;
+	BOOL			added = NO;
+
+	// see if there's anything to do
+	if (!error) {
+		if (legend == nil) {
+			error = YES;
+			NSLog(@"[Quip (Protected) -addToSolutionsWithLegend:] - the passed-in legend is nil and that really means that there's nothing for me to do. Please make sure the argument to this method is not nil before calling.");
+		}
+	}
+
+	// see if there's any place to put this guy
+	if (!error) {
+		if (([self getSolutions] == nil) || ([self getSolutionKeys] == nil)) {
+			error = YES;
+			NSLog(@"[Quip (Protected) -addToSolutionsWithLegend:] - the master storage of all solutions has not been created. This means that the -init method has probably not been called. Please make sure to properly initialize this object before using it.");
+		}
 	}
+
+	/*
+	 The workers share all this, and the handler is called while we still
+	 hold the lock, so that the solutions are handed out one at a time, and
+	 in the order they are in the list. If we've already got all we need -
+	 another worker got there first - then this one doesn't count.
+	 */
+	if (!error) {
+		@synchronized([self getSolutions]) {
+			NSUInteger	limit = [self getSolutionLimit];
+			if (((limit == 0) || ([[self getSolutions] count] < limit)) &&
+				![[self getSolutionKeys] containsObject:legend]) {
+				NSString*	dec = [legend decode:[self getCypherText]];
+				if (dec != nil) {
+					Legend*		key = [legend copy];
+					[[self getSolutionKeys] addObject:key];
+					[[self getSolutions] addObject:dec];
+					added = YES;
+#ifdef QUIP_INSTRUMENTATION
+					if ([[self getSolutions] count] == 1) {
+						_statistics.firstSolutionTime = [NSDate timeIntervalSinceReferenceDate] - _searchStart;
+					}
+#endif
+					if ([self getSolutionHandler] != nil) {
+						[self getSolutionHandler](key, dec);
+					}
+				}
+			}
+			if ((limit > 0) && ([[self getSolutions] count] >= limit)) {
+				[self setCancelled:YES];
+			}
+		}
+	}
+
+	return added;
+}
+
+
+/*!
+ This method sets the flag that tells the running attack to stop. It's the
+ way the attacks are cancelled - by the caller, or by a parallel attack
+ that has found all the solutions it was looking for.
+
+ @param flag YES if the attack should stop as soon as it can
+ */
+- (void) setCancelled:(BOOL)flag
+{
+	_cancelled = flag;
 }
 
 
@@ -271,12 +455,452 @@
 //----------------------------------------------------------------------------
 
 /*!
- This is the recursive entry point for attempting the "Word Block" attack on
- the cyphertext starting at the 'index'th word in the quip. The idea is that
+ This method gets the puzzle ready for one of the attacks. The pieces are
+ sorted so the one with the fewest possibles is first, the letter codes of
+ all the possibles are made - so the search on many threads doesn't have to
+ - and the cancelled flag is cleared.
+ */
+- (void) prepareForAttack
+{
+	// sort the puzzle pieces by the number of possible words they match
+	[[self getPuzzlePieces] sortUsingSelector:@selector(comparePossibles:)];
+	// ...make sure the codes are there for the search
+	for (PuzzlePiece* pp in [self getPuzzlePieces]) {
+		[pp getPossibleCodes];
+	}
+	// ...and we're not cancelled - yet
+	[self setCancelled:NO];
+}
+
+
+/*!
+ This method builds the tables - as described in MatchKernel.h - of which
+ possibles of each puzzle piece can go with which possibles of each of the
+ other pieces it shares a cypher letter with. They are in the order the
+ pieces are in, so this needs to be done after they are sorted, and if
+ they are already built for the pieces in this order, they are kept. The
+ tables are built on the shared WorkPool, and the pairs with tables that
+ would be too big to pay for themselves are left out - the forward checking
+ filters those the old way.
+ */
+- (void) buildPairTables
+{
+	BOOL		error = NO;
+	NSArray*	pieces = [self getPuzzlePieces];
+	NSUInteger	count = [pieces count];
+
+	// if we already have them for these pieces, in this order, we're done
+	BOOL		same = ((_pairTables != NULL) && ([_pairedPieces count] == count));
+	for (NSUInteger i = 0; same && (i < count); ++i) {
+		same = ([_pairedPieces objectAtIndex:i] == [pieces objectAtIndex:i]);
+	}
+	if (same) {
+		return;
+	}
+
+	// start from scratch - one table for every ordered pair, most empty
+	[self freePairTables];
+	if (!error) {
+		_pairTables = calloc(count * count + 1, sizeof(MKPairTable));
+		if (_pairTables == NULL) {
+			error = YES;
+			NSLog(@"[Quip (Protected) -buildPairTables] - the storage for the tables of %lu puzzle pieces could not be created. This is a serious allocation error and needs to be looked into as soon as possible.", (unsigned long)count);
+		} else {
+			_pairedPieces = [pieces copy];
+		}
+	}
+
+	// make a task for each pair that shares a letter, and isn't too big
+	if (!error) {
+		NSMutableArray*	tasks = [NSMutableArray array];
+		size_t			total = 0;
+		for (NSUInteger i = 0; i < count; ++i) {
+			PuzzlePiece*		from = [pieces objectAtIndex:i];
+			const MKColumns*	fromCols = [from getPossibleColumns];
+			for (NSUInteger j = 0; j < count; ++j) {
+				PuzzlePiece*		to = [pieces objectAtIndex:j];
+				const MKColumns*	toCols = [to getPossibleColumns];
+				size_t				size = (size_t)fromCols->count * mk_mask_words(toCols->count);
+				if ((i == j) || (([[from getCypherWord] getLetterMask] & [[to getCypherWord] getLetterMask]) == 0) ||
+					(size > PAIR_TABLE_MAX_WORDS) || (total + size > PAIR_TABLE_TOTAL_WORDS)) {
+					continue;
+				}
+				total += size;
+				MKPairTable*		table = &_pairTables[i * count + j];
+				const uint8_t*		rows = [from getPossibleCodes];
+				const uint8_t*		cw = [[from getCypherWord] getCode];
+				const uint8_t*		ocw = [[to getCypherWord] getCode];
+				[tasks addObject:[^{
+					if (mk_pair_build(table, rows, fromCols->count, fromCols->length, cw, toCols, ocw) != 0) {
+						NSLog(@"[Quip (Protected) -buildPairTables] - the table of %u by %u possibles could not be created. This is a serious allocation error and needs to be looked into as soon as possible.", fromCols->count, toCols->count);
+					}
+				} copy]];
+			}
+		}
+		[[WorkPool sharedWorkPool] runTasksAndWait:tasks];
+	}
+}
+
+
+/*!
+ This method frees up all the tables of the pairs of puzzle pieces, so
+ that they will be built again the next time they are needed.
+ */
+- (void) freePairTables
+{
+	if (_pairTables != NULL) {
+		for (NSUInteger i = 0; i < [_pairedPieces count] * [_pairedPieces count]; ++i) {
+			mk_pair_free(&_pairTables[i]);
+		}
+		free(_pairTables);
+		_pairTables = NULL;
+	}
+	_pairedPieces = nil;
+}
+
+
+/*!
+ This method returns the table of which possibles of the 'from'th puzzle
+ piece can go with which of the 'to'th, or NULL if there isn't one.
+
+ @param from The zero-biased index of the piece that gets its word
+ @param to The zero-biased index of the piece that's narrowed
+ @return The MKPairTable of the two pieces, or NULL
+ */
+- (const MKPairTable*) getPairTableFrom:(NSUInteger)from to:(NSUInteger)to
+{
+	const MKPairTable*	table = NULL;
+	NSUInteger			count = [_pairedPieces count];
+	if ((_pairTables != NULL) && (from < count) && (to < count) &&
+		(_pairTables[from * count + to].bits != NULL)) {
+		table = &_pairTables[from * count + to];
+	}
+	return table;
+}
+
+
+/*!
+ This method gets the table of nogoods ready for an attack - it's made if
+ it's not there, and emptied out if it is - and works out the cypher
+ letters of the puzzle pieces from each one to the end, in the order they
+ are in now, so the search can tell what's left to do at each depth. It
+ needs to be done after the pieces are sorted.
+ */
+- (void) resetNogoodTable
+{
+	BOOL		error = NO;
+	NSArray*	pieces = [self getPuzzlePieces];
+	NSUInteger	count = [pieces count];
+
+	// make the table the first time, and just empty it out after that
+	if (!error) {
+		if (_nogoods.entries == NULL) {
+			if (ng_init(&_nogoods, NOGOOD_TABLE_PLACES) != 0) {
+				error = YES;
+				NSLog(@"[Quip (Protected) -resetNogoodTable] - the table of %d nogoods could not be created. This is a serious allocation error and needs to be looked into as soon as possible.", NOGOOD_TABLE_PLACES);
+			}
+		} else {
+			ng_clear(&_nogoods);
+		}
+	}
+
+	// ...and the letters left to map from each piece on - the last is none
+	if (!error) {
+		free(_remainingLetters);
+		_remainingLetters = calloc(count + 1, sizeof(uint32_t));
+		if (_remainingLetters == NULL) {
+			error = YES;
+			NSLog(@"[Quip (Protected) -resetNogoodTable] - the letters of %lu puzzle pieces could not be created. This is a serious allocation error and needs to be looked into as soon as possible.", (unsigned long)count);
+		} else {
+			for (NSUInteger i = count; i > 0; --i) {
+				_remainingLetters[i - 1] = _remainingLetters[i] | [[[pieces objectAtIndex:(i - 1)] getCypherWord] getLetterMask];
+			}
+		}
+	}
+
+	// without the letters, the table is no good to anyone
+	if (error) {
+		[self freeNogoodTable];
+	}
+}
+
+
+/*!
+ This method frees up the table of nogoods, and the cypher letters that go
+ with it.
+ */
+- (void) freeNogoodTable
+{
+	ng_free(&_nogoods);
+	free(_remainingLetters);
+	_remainingLetters = NULL;
+}
+
+
+/*!
+ This method splits the puzzle pieces into the groups that are connected
+ by the cypher letters that aren't in the starting legend - two pieces are
+ in the same group if they share one of those, or are both in a group with
+ a third. The groups have nothing to say about each other's words, save
+ that they can't use the same plaintext letters, so each can be solved on
+ its own. The pieces stay in the order they are in now.
+
+ @param
+ @return The array of the groups, each an array of PuzzlePieces
+ */
+- (NSArray*) getComponents
+{
+	NSArray*	pieces = [self getPuzzlePieces];
+	uint32_t	known = [[self getStartingLegend] getCypherMask];
+
+	/*
+	 Each group is the set of unknown cypher letters in it - a piece joins
+	 every group it shares a letter with, and they all become one.
+	 */
+	NSUInteger	count = [pieces count];
+	uint32_t	letters[count + 1];
+	NSUInteger	groups = 0;
+	for (PuzzlePiece* pp in pieces) {
+		uint32_t	mine = [[pp getCypherWord] getLetterMask] & ~known;
+		if (mine != 0) {
+			NSUInteger	kept = 0;
+			for (NSUInteger g = 0; g < groups; ++g) {
+				if ((letters[g] & mine) != 0) {
+					mine |= letters[g];
+				} else {
+					letters[kept++] = letters[g];
+				}
+			}
+			letters[kept] = mine;
+			groups = kept + 1;
+		}
+	}
+
+	/*
+	 ...and then deal out the pieces to the groups they ended up in, in the
+	 order the groups first show up. A piece with no unknown letters at all
+	 is a group of its own.
+	 */
+	NSMutableArray*	components = [NSMutableArray array];
+	NSInteger		slot[groups + 1];
+	for (NSUInteger g = 0; g < groups; ++g) {
+		slot[g] = -1;
+	}
+	for (PuzzlePiece* pp in pieces) {
+		uint32_t		mine = [[pp getCypherWord] getLetterMask] & ~known;
+		NSMutableArray*	group = nil;
+		for (NSUInteger g = 0; (mine != 0) && (group == nil) && (g < groups); ++g) {
+			if ((letters[g] & mine) != 0) {
+				if (slot[g] < 0) {
+					slot[g] = (NSInteger)[components count];
+					[components addObject:[NSMutableArray array]];
+				}
+				group = [components objectAtIndex:(NSUInteger)slot[g]];
+			}
+		}
+		if (group == nil) {
+			group = [NSMutableArray array];
+			[components addObject:group];
+		}
+		[group addObject:pp];
+	}
+	return components;
+}
+
+
+/*!
+ This method solves each of the groups of puzzle pieces from -getComponents
+ as a Quip of its own - all at once, on the shared WorkPool - and then puts
+ the legends of those solutions together, one from each group, to make the
+ solutions of the whole quip. Only the legends that don't give the same
+ plaintext letter to cypher letters in two groups go together.
+
+ With a limit, the groups are solved lazily: first for one solution each,
+ and then, if putting them together comes up short of the limit, the ones
+ that might have more are solved again for twice as many, until there are
+ enough, or every group has given up all it has. Without a limit, each is
+ solved for all of its solutions at once. It stops as soon as it has the
+ limit of solutions, or if one of the groups has none.
+
+ The statistics of the groups are added into this quip's, but the depths
+ - the nodes at each depth, and the deepest - are the depths within each
+ group, not in the whole quip.
+
+ @param components The array of the groups of PuzzlePieces to solve
+ @param options The QuipAttackOptions for the attack on each group
+ @return YES if the attack on the puzzle was successful
+ */
+- (BOOL) runComponentAttacks:(NSArray*)components options:(QuipAttackOptions)options
+{
+	// make a Quip of each group - its words, its pieces, and the same hint
+	NSMutableArray*	parts = [NSMutableArray arrayWithCapacity:[components count]];
+	for (NSArray* group in components) {
+		Quip*			part = [[Quip alloc] init];
+		NSMutableArray*	words = [NSMutableArray arrayWithCapacity:[group count]];
+		for (PuzzlePiece* pp in group) {
+			[words addObject:[[pp getCypherWord] getCypherText]];
+			[part addToPuzzlePieces:pp];
+		}
+		[part setCypherText:[words componentsJoinedByString:@" "]];
+		[part setStartingLegend:[self getStartingLegend]];
+		[parts addObject:part];
+	}
+	// ...so that -cancelAttack can get to them
+	@synchronized(self) {
+		_componentQuips = parts;
+	}
+
+	/*
+	 Solve the groups that might have more solutions - all of them, the first
+	 time - for 'most' solutions each, and put together what we have. If any
+	 one of them has none, then neither does the whole quip, and the rest can
+	 stop right there. A group that comes back with fewer than it was asked
+	 for has given up all it has, and it's never solved again.
+	 */
+	NSUInteger		limit = [self getSolutionLimit];
+	NSUInteger		most = (limit > 0 ? 1 : 0);
+	NSMutableArray*	pending = [NSMutableArray arrayWithArray:parts];
+	__block volatile BOOL	failed = NO;
+	while (([pending count] > 0) && !failed && ![self isCancelled]) {
+		NSMutableArray*	tasks = [NSMutableArray arrayWithCapacity:[pending count]];
+		for (Quip* part in pending) {
+			[tasks addObject:[^{
+				if (!failed && ![self isCancelled]) {
+					if (![part attemptWordBlockAttackWithOptions:options limit:most solutionHandler:nil]) {
+						failed = YES;
+						for (Quip* other in parts) {
+							[other cancelAttack];
+						}
+					}
+					__sync_fetch_and_add(&_nodeCount, [part getNodeCount]);
+				}
+			} copy]];
+		}
+		[[WorkPool sharedWorkPool] runTasksAndWait:tasks];
+#ifdef QUIP_INSTRUMENTATION
+		for (Quip* part in pending) {
+			for (NSUInteger d = 0; d < QUIP_STAT_DEPTHS; ++d) {
+				QUIP_STAT_ADD(nodesAtDepth[d], part->_statistics.nodesAtDepth[d]);
+			}
+			QUIP_STAT_ADD(matchChecks, part->_statistics.matchChecks);
+			QUIP_STAT_ADD(matchRejects, part->_statistics.matchRejects);
+			QUIP_STAT_ADD(incorporates, part->_statistics.incorporates);
+			QUIP_STAT_ADD(incorporateFailures, part->_statistics.incorporateFailures);
+			QUIP_STAT_ADD(legendCopies, part->_statistics.legendCopies);
+			QUIP_STAT_ADD(backtracks, part->_statistics.backtracks);
+			QUIP_STAT_ADD(backjumps, part->_statistics.backjumps);
+			QUIP_STAT_ADD(nogoodProbes, part->_statistics.nogoodProbes);
+			QUIP_STAT_ADD(nogoodHits, part->_statistics.nogoodHits);
+			QUIP_STAT_ADD(nogoodStores, part->_statistics.nogoodStores);
+			if (part->_statistics.maxDepth > _statistics.maxDepth) {
+				_statistics.maxDepth = part->_statistics.maxDepth;
+			}
+		}
+#endif
+		if (failed || [self isCancelled]) {
+			break;
+		}
+
+		/*
+		 Now put them together - the groups with the fewest solutions first,
+		 so that a clash over a plaintext letter is found as soon as it can
+		 be. The solutions from the last time around are found again, but
+		 they are already in the solutions, so they don't count twice.
+		 */
+		NSMutableArray*	legends = [NSMutableArray arrayWithCapacity:[parts count]];
+		for (Quip* part in parts) {
+			[legends addObject:[[part getSolutionKeys] allObjects]];
+		}
+		[legends sortUsingComparator:^NSComparisonResult(id a, id b) {
+			NSUInteger	x = [a count];
+			NSUInteger	y = [b count];
+			return (x < y ? NSOrderedAscending : (x > y ? NSOrderedDescending : NSOrderedSame));
+		}];
+		QUIP_STAT_ADD(legendCopies, 1);
+		[self combineComponentLegends:legends fromIndex:0 withLegend:[[self getStartingLegend] copy]];
+
+		// ...and if that's not enough, ask the ones that might have more
+		NSMutableArray*	more = [NSMutableArray array];
+		for (Quip* part in pending) {
+			if ((most > 0) && ([[part getSolutions] count] >= most)) {
+				[more addObject:part];
+			}
+		}
+		pending = more;
+		most *= 2;
+	}
+
+	@synchronized(self) {
+		_componentQuips = nil;
+	}
+	return ([[self getSolutions] count] > 0);
+}
+
+
+/*!
+ This is the recursive part of putting the solutions of the groups back
+ together. The legend has one solution from each of the groups before the
+ 'index'th, and each of the legends of the 'index'th group is added to it
+ in turn - if it doesn't give away a plaintext letter that's already been
+ given away - and then the rest of the groups are added, until they are all
+ there, and it's a solution to the whole quip. The legend is just as it was
+ passed in when this returns.
+
+ @param legends The array of the arrays of Legends of each group's solutions
+ @param index The zero-biased index of the group to add to the legend
+ @param legend The Legend (key) with the groups before the index in it
+ */
+- (void) combineComponentLegends:(NSArray*)legends fromIndex:(NSUInteger)index withLegend:(Legend*)legend
+{
+	// if every group is in there, it's a solution to the whole thing
+	if (index == [legends count]) {
+		[self addToSolutionsWithLegend:legend];
+		return;
+	}
+
+	NSUInteger	mark = [legend getMark];
+	for (Legend* part in [legends objectAtIndex:index]) {
+		if ([self isCancelled]) {
+			break;
+		}
+		/*
+		 The legend checks that each plaintext letter is only given to one
+		 cypher letter as it adds them, so it's the one to ask. The hint is
+		 in both, but that's no clash, as it's the same mapping.
+		 */
+		uint8_t		cw[26];
+		uint8_t		pw[26];
+		NSUInteger	len = 0;
+		unichar*	map = [part getMap];
+		for (NSUInteger c = 0; c < 26; ++c) {
+			if (map[c] != '\0') {
+				cw[len] = (uint8_t)c;
+				pw[len++] = (uint8_t)(map[c] - 'a');
+			}
+		}
+		if ([legend incorporateCode:cw toPlain:pw length:len]) {
+			QUIP_STAT_ADD(incorporates, 1);
+			[self combineComponentLegends:legends fromIndex:(index + 1) withLegend:legend];
+			[legend rollbackToMark:mark];
+		} else {
+			QUIP_STAT_ADD(incorporateFailures, 1);
+		}
+	}
+}
+
+
+/*!
+ This is the entry point for attempting the "Word Block" attack on the
+ cyphertext starting at the 'index'th word in the quip. The idea is that
  we start with the provided legend, and then for each plaintext word in the
  'index'ed cypherword that matches the legend, we add those keys not in
  the legend, but supplied by the plaintext to the legend, and then try the
  next cypherword in the same manner.
+
+ This gets the levels of the letters that are already in the legend ready
+ for the backjumping, and starts the recursion. The letters of the hint
+ can't be undone, and the rest were added before the 'index'th word, so
+ they are put down to the word just before it.
  
  If this attack results in a successful decoding of the cyphertext, this method
  will return YES, otherwise, it will return NO.
@@ -286,46 +910,576 @@
  @return YES if the attack on the puzzle was successful
  */
 - (BOOL) doWordBlockAttackOnIndex:(NSUInteger)index withLegend:(Legend*)key
+{
+	uint8_t		levels[26];
+	uint64_t	conflicts = 0;
+	uint32_t	hint = [[self getStartingLegend] getCypherMask];
+	for (NSUInteger c = 0; c < 26; ++c) {
+		levels[c] = (((index == 0) || (hint & (1u << c))) ? MK_NO_LEVEL : (uint8_t)(index - 1));
+	}
+	BOOL		backjump = ([[self getPuzzlePieces] count] <= QUIP_MAX_BACKJUMP_LEVELS);
+	return [self doWordBlockAttackOnIndex:index withLegend:key levels:(backjump ? levels : NULL) conflicts:&conflicts];
+}
+
+
+/*!
+ This is the recursive part of the "Word Block" attack - each possible of
+ the 'index'th piece that fits the legend is added to it, and the next
+ piece is tried with that, until the last piece decodes the whole quip.
+
+ The legend is used for every guess at every level - it's added to on the
+ way down, and rolled back on the way up - so it's not copied, and it's
+ just as it was passed in when this returns.
+
+ This search backjumps. 'levels' has, for each cypher letter in the legend,
+ the index of the piece whose word mapped it - or MK_NO_LEVEL for the hint
+ - and when a piece runs out of words, the levels whose letters ruled them
+ out are returned in 'conflicts', as a mask with bit n for the nth piece.
+ If this piece isn't in the conflicts of the piece after it, then no other
+ word here can help, so there's no point in trying the rest of them - this
+ returns right away, with those conflicts, and so on up to the deepest
+ piece that's in them. If 'levels' is NULL, there are too many pieces for
+ the mask, and every failure is put down to every level before it.
+
+ @param index The zero-biased index of PuzzlePieces to continue the attack on
+ @param key The Legend (key) to continue the attack with
+ @param levels The 26 element array of the levels that mapped each letter, or NULL
+ @param conflicts The levels that are to blame if this returns NO
+ @return YES if the attack on the puzzle was successful
+ */
+- (BOOL) doWordBlockAttackOnIndex:(NSUInteger)index withLegend:(Legend*)key levels:(uint8_t*)levels conflicts:(uint64_t*)conflicts
 {
 	BOOL	haveSolutions = NO;
+	__sync_fetch_and_add(&_nodeCount, 1);
+	_currentDepth = index;
+	QUIP_STAT_NODE(index);
+
+	// ...until we know better, it's the fault of every word before this one
+	uint64_t			before = (levels != NULL ? (1ULL << index) - 1 : MK_UNEXPLAINED);
+	uint64_t			blame = 0;
+	*conflicts = before;
+
+	/*
+	 If we've been here before - the same letters for the pieces that are
+	 left, and the same plaintext letters taken - by another path, and
+	 found nothing below it, there's nothing to find this time either.
+	 */
+	uint64_t			place = 0;
+	BOOL				remember = ((index > 0) && (_remainingLetters != NULL));
+	if (remember) {
+		place = ng_hash(0, (uint32_t)index, _remainingLetters[index], [key getMap], [key getPlainMask]);
+		QUIP_STAT_ADD(nogoodProbes, 1);
+		if (ng_lookup(&_nogoods, place, (uint32_t)index)) {
+			QUIP_STAT_ADD(nogoodHits, 1);
+			return NO;
+		}
+	}
+
+	// find all the possibles for this guy that can match - all at once
+	PuzzlePiece*		piece = [[self getPuzzlePieces] objectAtIndex:index];
+	const uint8_t*		cw = [[piece getCypherWord] getCode];
+	const uint8_t*		codes = [piece getPossibleCodes];
+	const MKColumns*	cols = [piece getPossibleColumns];
+	NSUInteger			len = [[piece getCypherWord] length];
+	size_t				words = mk_mask_words(cols->count);
+	uint64_t			live[words + 1];
+	uint32_t			found = mk_filter(cols, cw, [key getMap], live);
+	QUIP_STAT_ADD(matchChecks, cols->count);
+	QUIP_STAT_ADD(matchRejects, cols->count - found);
 
-	// check all the possibles for this guy to see if they can possibly match
-	PuzzlePiece*	piece = [[self getPuzzlePieces] objectAtIndex:index];
-	CypherWord*		cw = [piece getCypherWord];
-	NSString*		dec = nil;
-	for (NSString* pw in [piece getPossibles]) {
-		if ([cw canMatch:pw with:key]) {
-			// good! Now let's see if we are done with all the words
-			if (index == [[self getPuzzlePieces] count] - 1) {
-				// make sure we can really decode the last word
-				if ([key incorporateMappingCypher:cw toPlain:pw]) {
+	BOOL				last = (index == [[self getPuzzlePieces] count] - 1);
+	NSUInteger			mark = [key getMark];
+	BOOL				stop = (found == 0);
+	BOOL				jumped = NO;
+	for (size_t w = 0; !stop && (w < words); ++w) {
+		for (uint64_t bits = live[w]; !stop && (bits != 0); bits &= (bits - 1)) {
+			const uint8_t*	pw = codes + (w * MK_BLOCK + __builtin_ctzll(bits)) * len;
+			uint32_t		bound = [key getCypherMask];
+			/*
+			 Add in the assumed values from the plaintext to the legend,
+			 and if that works, either decode the whole quip - if this is
+			 the last word - or move on to the next word. Either way, roll
+			 the legend back to where it was when we're done, so we can
+			 try the next plaintext with it.
+			 */
+			if ([key incorporateCode:cw toPlain:pw length:len]) {
+				QUIP_STAT_ADD(incorporates, 1);
+				if (last) {
 					// if it's good, add the solution to the list
-					if ((dec = [key decode:[self getCypherText]]) != nil) {
-						if ([self addToSolutions:dec]) {
-							haveSolutions = YES;
+					if ([self addToSolutionsWithLegend:key]) {
+						haveSolutions = YES;
+					}
+					// ...and either way, there's no jumping back over it
+					blame = MK_UNEXPLAINED;
+				} else {
+					uint64_t	below = 0;
+					if (levels != NULL) {
+						for (uint32_t added = [key getCypherMask] & ~bound; added != 0; added &= (added - 1)) {
+							levels[__builtin_ctz(added)] = (uint8_t)index;
 						}
 					}
+					if ([self doWordBlockAttackOnIndex:(index + 1) withLegend:key levels:levels conflicts:&below]) {
+						haveSolutions = YES;
+					}
+					/*
+					 If this word had nothing to do with why the rest didn't
+					 work out, then none of the others will do any better -
+					 so jump back to the deepest word that did.
+					 */
+					if ((levels != NULL) && !haveSolutions && ((below & (1ULL << index)) == 0)) {
+						blame = below;
+						jumped = YES;
+						stop = YES;
+						QUIP_STAT_ADD(backjumps, 1);
+					} else {
+						blame |= below;
+					}
 				}
+				[key rollbackToMark:mark];
+				QUIP_STAT_ADD(backtracks, 1);
+			} else {
+				// the filter should have caught it, so we can't say why
+				blame = MK_UNEXPLAINED;
+				QUIP_STAT_ADD(incorporateFailures, 1);
+			}
+
+			// if we have all the solutions we need, or we've been told to stop - stop
+			stop = stop || [self isCancelled];
+		}
+	}
+
+	/*
+	 If we didn't jump, then this piece is out of words, and it's the fault
+	 of what ruled out each of them - the ones the filter ruled out, and the
+	 ones that didn't work out further down. It's never this piece's fault.
+	 */
+	if (!jumped && (levels != NULL) && (blame != MK_UNEXPLAINED)) {
+		blame |= mk_explain(cols, cw, [key getMap], levels, live);
+	}
+	*conflicts = (haveSolutions ? before : (blame & before));
+
+	// if we looked at all of it, and there was nothing, remember that
+	if (remember && !haveSolutions && ![self isCancelled]) {
+		ng_store(&_nogoods, place, (uint32_t)index);
+		QUIP_STAT_ADD(nogoodStores, 1);
+	}
+
+	return haveSolutions;
+}
+
+
+/*!
+ This method returns all the legends that come from extending the provided
+ legend with each of the possible plaintexts of the 'index'th puzzle piece
+ that it can match. These are the roots of the subtrees of the search that
+ the parallel attack hands out as tasks.
+
+ @param legend The Legend (key) to extend
+ @param index The zero-biased index of the PuzzlePiece to extend it with
+ @return The array of all the consistent, extended, Legends
+ */
+- (NSArray*) expandLegend:(Legend*)legend onIndex:(NSUInteger)index
+{
+	NSMutableArray*		kids = [NSMutableArray array];
+	PuzzlePiece*		piece = [[self getPuzzlePieces] objectAtIndex:index];
+	const uint8_t*		cw = [[piece getCypherWord] getCode];
+	const uint8_t*		codes = [piece getPossibleCodes];
+	const MKColumns*	cols = [piece getPossibleColumns];
+	NSUInteger			len = [[piece getCypherWord] length];
+	size_t				words = mk_mask_words(cols->count);
+	uint64_t			live[words + 1];
+	uint32_t			found = mk_filter(cols, cw, [legend getMap], live);
+	QUIP_STAT_NODE(index);
+	QUIP_STAT_ADD(matchChecks, cols->count);
+	QUIP_STAT_ADD(matchRejects, cols->count - found);
+	for (size_t w = 0; (found > 0) && (w < words); ++w) {
+		for (uint64_t bits = live[w]; bits != 0; bits &= (bits - 1)) {
+			const uint8_t*	pw = codes + (w * MK_BLOCK + __builtin_ctzll(bits)) * len;
+			Legend*			nextKey = [legend copy];
+			QUIP_STAT_ADD(legendCopies, 1);
+			if ([nextKey incorporateCode:cw toPlain:pw length:len]) {
+				QUIP_STAT_ADD(incorporates, 1);
+				[kids addObject:nextKey];
+			} else {
+				QUIP_STAT_ADD(incorporateFailures, 1);
+			}
+		}
+	}
+	return kids;
+}
+
+
+/*!
+ This method runs the "Word Block" attack from the 'index'th puzzle piece
+ with the provided legend - the pieces before it are assumed to already be
+ in the legend. The options say which order the rest of the pieces are to
+ be tried in: as they are sorted, or the most constrained one at each step,
+ and whether the possibles of the other pieces are to be forward checked.
+
+ @param index The zero-biased index of PuzzlePieces to start the attack on
+ @param legend The Legend (key) to start the attack with
+ @param options The QuipAttackOptions for this attack
+ @return YES if the attack on the puzzle was successful
+ */
+- (BOOL) runWordBlockAttackFromIndex:(NSUInteger)index withLegend:(Legend*)legend options:(QuipAttackOptions)options
+{
+	BOOL	haveSolutions = NO;
+
+	if ((options & (QuipAttackDynamicOrder | QuipAttackForwardCheck)) == 0) {
+		haveSolutions = [self doWordBlockAttackOnIndex:index withLegend:legend];
+	} else {
+		QuipSearchState		state;
+		if ([self createSearchState:&state fromIndex:index withLegend:legend options:options]) {
+			haveSolutions = [self doDynamicWordBlockAttackWithLegend:legend state:&state];
+		}
+		[self freeSearchState:&state];
+	}
+
+	return haveSolutions;
+}
+
+
+/*!
+ This method fills in the search state for the dynamic ordering and the
+ forward checking of the "Word Block" attack. The pieces before the
+ 'index'th are marked as having a word already, and the rest have their
+ possibles filtered and counted against the legend. If the state can't be
+ made, or one of the pieces has nothing left that's consistent with the
+ legend, this returns NO - but the state still needs to be freed with
+ -freeSearchState:.
+
+ @param state The QuipSearchState to fill in
+ @param index The zero-biased index of the first piece without a word
+ @param legend The Legend (key) to start the attack with
+ @param options The QuipAttackOptions for this attack
+ @return YES if the search has somewhere to go from here
+ */
+- (BOOL) createSearchState:(QuipSearchState*)state fromIndex:(NSUInteger)index withLegend:(Legend*)legend options:(QuipAttackOptions)options
+{
+	BOOL		error = NO;
+	NSArray*	pieces = [self getPuzzlePieces];
+	NSUInteger	count = [pieces count];
+	BOOL		forward = ((options & QuipAttackForwardCheck) != 0);
+
+	// get all the space we're going to need
+	memset(state, 0, sizeof(QuipSearchState));
+	if (!error) {
+		state->options = options;
+		state->count = count;
+		state->assigned = calloc(count + 1, sizeof(BOOL));
+		state->liveCounts = calloc(count + 1, sizeof(uint32_t));
+		state->letterMasks = calloc(count + 1, sizeof(uint32_t));
+		state->plainMasks = calloc(count + 1, sizeof(uint32_t));
+		state->cypherCodes = calloc(count + 1, sizeof(uint8_t*));
+		state->possibleCodes = calloc(count + 1, sizeof(uint8_t*));
+		state->columns = calloc(count + 1, sizeof(MKColumns*));
+		state->liveMasks = calloc(count + 1, sizeof(uint64_t*));
+		if ((state->assigned == NULL) || (state->liveCounts == NULL) ||
+			(state->letterMasks == NULL) || (state->plainMasks == NULL) ||
+			(state->cypherCodes == NULL) ||
+			(state->possibleCodes == NULL) || (state->columns == NULL) ||
+			(state->liveMasks == NULL)) {
+			error = YES;
+			NSLog(@"[Quip (Protected) -createSearchState:fromIndex:withLegend:options:] - the storage for the search state of %lu puzzle pieces could not be created. This is a serious allocation error and needs to be looked into as soon as possible.", (unsigned long)count);
+		}
+	}
+
+	// pull what we need out of the pieces, and size the masks
+	size_t		most = 1;
+	size_t		total = 0;
+	if (!error) {
+		for (NSUInteger i = 0; i < count; ++i) {
+			PuzzlePiece*	piece = [pieces objectAtIndex:i];
+			state->cypherCodes[i] = [[piece getCypherWord] getCode];
+			state->letterMasks[i] = [[piece getCypherWord] getLetterMask];
+			state->possibleCodes[i] = [piece getPossibleCodes];
+			state->columns[i] = [piece getPossibleColumns];
+			// ...a letter none of them use can be taken without touching it
+			state->plainMasks[i] = (state->columns[i]->letters == NULL ? 0x3ffffff : 0);
+			for (uint32_t p = 0; (state->columns[i]->letters != NULL) && (p < state->columns[i]->count); ++p) {
+				state->plainMasks[i] |= state->columns[i]->letters[p];
+			}
+			size_t		words = mk_mask_words(state->columns[i]->count);
+			if (words > most) {
+				most = words;
+			}
+			total += words;
+		}
+		state->scratch = calloc(most, sizeof(uint64_t));
+		if (state->scratch == NULL) {
+			error = YES;
+			NSLog(@"[Quip (Protected) -createSearchState:fromIndex:withLegend:options:] - the scratch mask of %lu words could not be created. This is a serious allocation error and needs to be looked into as soon as possible.", (unsigned long)most);
+		}
+	}
+
+	/*
+	 For forward checking, each piece gets its own mask, and the trail has
+	 to be able to hold every one of them once for each level of the search
+	 - that's as bad as it can get, as a level only saves a mask once.
+	 */
+	if (!error && forward) {
+		for (NSUInteger i = 0; !error && (i < count); ++i) {
+			state->liveMasks[i] = calloc(mk_mask_words(state->columns[i]->count) + 1, sizeof(uint64_t));
+			error = (state->liveMasks[i] == NULL);
+		}
+		if (!error) {
+			state->trail = calloc((total + 1) * (count + 1), sizeof(uint64_t));
+			state->trailPieces = calloc((count + 1) * (count + 1), sizeof(NSUInteger));
+			error = ((state->trail == NULL) || (state->trailPieces == NULL));
+		}
+		if (error) {
+			NSLog(@"[Quip (Protected) -createSearchState:fromIndex:withLegend:options:] - the masks and trail for forward checking %lu puzzle pieces could not be created. This is a serious allocation error and needs to be looked into as soon as possible.", (unsigned long)count);
+		}
+		// ...and the tables of the pairs are only any good for these pieces
+		if ([_pairedPieces count] == count) {
+			state->pairTables = _pairTables;
+		}
+	}
+
+	// the ones before the index have their words - filter the rest
+	if (!error) {
+		const uint16_t*		map = [legend getMap];
+		for (NSUInteger i = 0; i < count; ++i) {
+			if (i < index) {
+				state->assigned[i] = YES;
+				++state->assignedCount;
+				state->assignedKey ^= NOGOOD_PIECE_KEY(i);
 			} else {
+				uint64_t*	mask = (forward ? state->liveMasks[i] : state->scratch);
+				state->liveCounts[i] = mk_filter(state->columns[i], state->cypherCodes[i], map, mask);
+				QUIP_STAT_ADD(matchChecks, state->columns[i]->count);
+				QUIP_STAT_ADD(matchRejects, state->columns[i]->count - state->liveCounts[i]);
+				if (state->liveCounts[i] == 0) {
+					error = YES;
+				}
+			}
+		}
+	}
+
+	return !error;
+}
+
+
+/*!
+ This method frees up everything in the search state, and clears it out
+ so that it's safe to free it again.
+
+ @param state The QuipSearchState to free
+ */
+- (void) freeSearchState:(QuipSearchState*)state
+{
+	if (state != NULL) {
+		if (state->liveMasks != NULL) {
+			for (NSUInteger i = 0; i < state->count; ++i) {
+				free(state->liveMasks[i]);
+			}
+		}
+		free(state->assigned);
+		free(state->liveCounts);
+		free(state->letterMasks);
+		free(state->plainMasks);
+		free((void*)state->cypherCodes);
+		free((void*)state->possibleCodes);
+		free((void*)state->columns);
+		free(state->scratch);
+		free(state->liveMasks);
+		free(state->trail);
+		free(state->trailPieces);
+		memset(state, 0, sizeof(QuipSearchState));
+	}
+}
+
+
+/*!
+ This is the recursive entry point for the dynamic ordering and forward
+ checking of the "Word Block" attack. With the dynamic ordering, rather
+ than take the pieces in the order they're sorted in, at each step this
+ picks the piece without a word that has the fewest possibles still
+ consistent with the legend. With forward checking, each word that's added
+ to the legend narrows the possibles of the other pieces, so they don't
+ have to be filtered again when their turn comes. Either way, only the
+ pieces that have a cypher letter that was just added to the legend, or a
+ possible that needs a plaintext letter that was just taken, are looked
+ at - the rest can't have changed - and if any of them goes to zero,
+ there's no point in going any deeper.
+
+ The legend and the state are both just as they were passed in when this
+ returns.
+
+ @param legend The Legend (key) to continue the attack with
+ @param state The QuipSearchState of the search so far
+ @return YES if the attack on the puzzle was successful
+ */
+- (BOOL) doDynamicWordBlockAttackWithLegend:(Legend*)legend state:(QuipSearchState*)state
+{
+	BOOL	haveSolutions = NO;
+	BOOL	forward = ((state->options & QuipAttackForwardCheck) != 0);
+	__sync_fetch_and_add(&_nodeCount, 1);
+	_currentDepth = state->assignedCount;
+	QUIP_STAT_NODE(state->assignedCount);
+
+	// if every piece has a word, then the legend should decode it all
+	if (state->assignedCount == state->count) {
+		return [self addToSolutionsWithLegend:legend];
+	}
+
+	/*
+	 Same as the fixed order - if these pieces have been left with these
+	 letters before, and there was nothing below, there's nothing now. Only
+	 here the pieces that are left aren't just the depth, so they go in,
+	 too. It doesn't matter which order they'd be picked in - or how far
+	 their possibles have been narrowed - as that's all from the legend.
+	 */
+	uint32_t		letters = 0;
+	for (NSUInteger i = 0; i < state->count; ++i) {
+		if (!state->assigned[i]) {
+			letters |= state->letterMasks[i];
+		}
+	}
+	uint64_t		place = 0;
+	BOOL			remember = ((state->assignedCount > 0) && (_nogoods.entries != NULL));
+	if (remember) {
+		place = ng_hash(state->assignedKey, (uint32_t)state->assignedCount, letters, [legend getMap], [legend getPlainMask]);
+		QUIP_STAT_ADD(nogoodProbes, 1);
+		if (ng_lookup(&_nogoods, place, (uint32_t)state->assignedCount)) {
+			QUIP_STAT_ADD(nogoodHits, 1);
+			return NO;
+		}
+	}
+
+	/*
+	 Pick the next piece - the one with the fewest possibles left, as it's
+	 the most constrained, or if we're not ordering them, the next one in
+	 the order they're sorted in.
+	 */
+	NSUInteger		index = state->count;
+	for (NSUInteger i = 0; i < state->count; ++i) {
+		if (!state->assigned[i] && ((index == state->count) || (state->liveCounts[i] < state->liveCounts[index]))) {
+			index = i;
+			if ((state->options & QuipAttackDynamicOrder) == 0) {
+				break;
+			}
+		}
+	}
+	if (state->liveCounts[index] == 0) {
+		return NO;
+	}
+
+	// get all the possibles for this guy that can match - all at once
+	const uint8_t*		cw = state->cypherCodes[index];
+	const uint8_t*		codes = state->possibleCodes[index];
+	const MKColumns*	cols = state->columns[index];
+	NSUInteger			len = cols->length;
+	size_t				words = mk_mask_words(cols->count);
+	uint64_t			live[words + 1];
+	if (forward) {
+		memcpy(live, state->liveMasks[index], words * sizeof(uint64_t));
+	} else {
+		mk_filter(cols, cw, [legend getMap], live);
+		QUIP_STAT_ADD(matchChecks, cols->count);
+		QUIP_STAT_ADD(matchRejects, cols->count - state->liveCounts[index]);
+	}
+
+	// this one has its word now, and we'll need the counts to go back to
+	state->assigned[index] = YES;
+	++state->assignedCount;
+	state->assignedKey ^= NOGOOD_PIECE_KEY(index);
+	uint32_t			saved[state->count + 1];
+	memcpy(saved, state->liveCounts, state->count * sizeof(uint32_t));
+
+	NSUInteger			mark = [legend getMark];
+	size_t				trailPieceMark = state->trailPieceCount;
+	BOOL				stop = NO;
+	for (size_t w = 0; !stop && (w < words); ++w) {
+		for (uint64_t bits = live[w]; !stop && (bits != 0); bits &= (bits - 1)) {
+			uint32_t		pick = (uint32_t)(w * MK_BLOCK + __builtin_ctzll(bits));
+			const uint8_t*	pw = codes + pick * len;
+			uint32_t		before = [legend getCypherMask];
+			uint32_t		beforePlain = [legend getPlainMask];
+			if ([legend incorporateCode:cw toPlain:pw length:len]) {
+				QUIP_STAT_ADD(incorporates, 1);
 				/*
-				 OK, we had a match but we have more cypherwords
-				 to check. So, copy the legend, add in the assumed
-				 values from the plaintext, and move to the next 
-				 word.
+				 Only the pieces with one of the cypher letters that were
+				 just added - or with a possible that uses one of the
+				 plaintext letters that were just taken - can have fewer
+				 possibles now, so just look at those - narrowing their
+				 masks if we're forward checking, and saving them first so
+				 they can be put back - and if any of them is out of
+				 possibles, this word is a dead end. That way the counts are
+				 always right, for the ordering and for finding dead ends.
+				 The pieces with a table with this one are narrowed by the
+				 row of this word, which is all the filter would have done.
 				 */
-				Legend*	nextKey = [key copy];
-				if ([nextKey incorporateMappingCypher:cw toPlain:pw]) {
-					haveSolutions = [self doWordBlockAttackOnIndex:(index + 1) withLegend:nextKey];
+				uint32_t			bound = [legend getCypherMask] & ~before;
+				uint32_t			taken = [legend getPlainMask] & ~beforePlain;
+				const uint16_t*		map = [legend getMap];
+				BOOL				dead = NO;
+				for (NSUInteger i = 0; !dead && (i < state->count); ++i) {
+					const MKPairTable*	table = NULL;
+					if (state->pairTables != NULL) {
+						table = &state->pairTables[index * state->count + i];
+						if (table->bits == NULL) {
+							table = NULL;
+						}
+					}
+					if (!state->assigned[i] && (bound != 0) &&
+						((table != NULL) || ((state->letterMasks[i] & bound) != 0) || ((state->plainMasks[i] & taken) != 0))) {
+						if (forward) {
+							size_t		n = mk_mask_words(state->columns[i]->count);
+							memcpy(state->trail + state->trailLength, state->liveMasks[i], n * sizeof(uint64_t));
+							state->trailLength += n;
+							state->trailPieces[state->trailPieceCount++] = i;
+							// the ones that were left are checked, and the rest rejected
+							QUIP_STAT_ADD(matchChecks, state->liveCounts[i]);
+							QUIP_STAT_ADD(matchRejects, state->liveCounts[i]);
+							if (table != NULL) {
+								state->liveCounts[i] = mk_pair_narrow(table, pick, state->liveMasks[i]);
+							} else {
+								state->liveCounts[i] = mk_narrow(state->columns[i], state->cypherCodes[i], map, state->liveMasks[i]);
+							}
+							QUIP_STAT_SUB(matchRejects, state->liveCounts[i]);
+						} else {
+							state->liveCounts[i] = mk_filter(state->columns[i], state->cypherCodes[i], map, state->scratch);
+							QUIP_STAT_ADD(matchChecks, state->columns[i]->count);
+							QUIP_STAT_ADD(matchRejects, state->columns[i]->count - state->liveCounts[i]);
+						}
+						dead = (state->liveCounts[i] == 0);
+					}
 				}
+				if (!dead && [self doDynamicWordBlockAttackWithLegend:legend state:state]) {
+					haveSolutions = YES;
+				}
+
+				// put back the masks we narrowed - last one saved, first one back
+				while (state->trailPieceCount > trailPieceMark) {
+					NSUInteger	i = state->trailPieces[--state->trailPieceCount];
+					size_t		n = mk_mask_words(state->columns[i]->count);
+					state->trailLength -= n;
+					memcpy(state->liveMasks[i], state->trail + state->trailLength, n * sizeof(uint64_t));
+				}
+				memcpy(state->liveCounts, saved, state->count * sizeof(uint32_t));
+				[legend rollbackToMark:mark];
+				QUIP_STAT_ADD(backtracks, 1);
+			} else {
+				QUIP_STAT_ADD(incorporateFailures, 1);
 			}
-		}
 
-		// if we have a solution - stop looking
-		if (haveSolutions) {
-			break;
+			// if we have all the solutions we need, or we've been told to stop - stop
+			stop = [self isCancelled];
 		}
 	}
-	
+
+	// ...and put this guy back the way we found him
+	state->assigned[index] = NO;
+	--state->assignedCount;
+	state->assignedKey ^= NOGOOD_PIECE_KEY(index);
+
+	// if we looked at all of it, and there was nothing, remember that
+	if (remember && !haveSolutions && ![self isCancelled]) {
+		ng_store(&_nogoods, place, (uint32_t)state->assignedCount);
+		QUIP_STAT_ADD(nogoodStores, 1);
+	}
+
 	return haveSolutions;
 }
 
@@ -0,0 +1,231 @@
+//
+//  SolutionCache.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/16/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+#import <Foundation/Foundation.h>
+
+// System Headers
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "Legend.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Public Data Types
+
+// Public Constants
+
+// Public Macros
+
+
+/*!
+ @class SolutionCache
+ This class is the cache of the solutions to the quips we've already seen,
+ so that a quip that comes around again doesn't have to be solved again.
+ Each quip is put in a canonical form first - the cypher letters renamed in
+ the order they first show up, the case folded, and the runs of spaces made
+ single spaces - along with the hint. That way the same quip, no matter
+ the key it was encyphered with, the capitalization, or the spacing, is
+ the same entry, and its solutions are kept as legends in that canonical
+ form, which are turned back into legends for the quip that was asked for.
+ They are kept sorted, so a smaller limit always gets the same ones. The
+ key has the identity of the words the solutions came from, too - the path
+ of the file, when it was last changed, and its size - so that a cache
+ file that's loaded with other words, or the same ones after an edit,
+ doesn't answer with solutions those words might not give.
+
+ The most recently used entries are kept, up to the capacity, and if the
+ cache was made with a file, it's loaded from there, and saved back to it
+ every so often, and on -save, so that it survives a restart. It's safe to
+ use from many threads at once.
+ */
+@interface SolutionCache : NSObject {
+@private
+	NSUInteger				_capacity;
+	NSString*				_path;
+	NSString*				_dictionary;
+	NSMutableDictionary*	_entries;
+	NSMutableDictionary*	_lastUsed;
+	NSUInteger				_tick;
+	NSUInteger				_unsaved;
+	NSUInteger				_hits;
+	NSUInteger				_misses;
+}
+
+//----------------------------------------------------------------------------
+//					Creation Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method allows the caller to create an autoreleased SolutionCache that
+ holds, at most, the provided number of quips - in memory only.
+
+ @param capacity The most quips to hold on to
+ @return newly created SolutionCache
+ */
++ (SolutionCache*) createSolutionCache:(NSUInteger)capacity;
+
+/*!
+ This method allows the caller to create an autoreleased SolutionCache that
+ holds, at most, the provided number of quips solved with the words in the
+ provided words file, and is loaded from, and saved to, the file at the
+ provided path.
+
+ @param capacity The most quips to hold on to
+ @param path The file to load and save the cache with
+ @param words The words file the quips are solved with
+ @return newly created SolutionCache
+ */
++ (SolutionCache*) createSolutionCache:(NSUInteger)capacity withFile:(NSString*)path forWordsFile:(NSString*)words;
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the most quips this cache will hold on to.
+
+ @param
+ @return The capacity of the cache
+ */
+- (NSUInteger) getCapacity;
+
+/*!
+ This method returns the file this cache is loaded from, and saved to - or
+ nil if it's only in memory.
+
+ @param
+ @return The path of the file for the cache
+ */
+- (NSString*) getPath;
+
+/*!
+ This method returns the identity of the words the quips in this cache are
+ solved with - the path of the words file, when it was last changed, and
+ its size - or the empty string if it wasn't made with a words file.
+
+ @param
+ @return The identity of the words for the cache
+ */
+- (NSString*) getDictionary;
+
+
+/*!
+ This method returns the number of quips in the cache right now.
+
+ @param
+ @return Count of quips in the cache
+ */
+- (NSUInteger) getCount;
+
+/*!
+ This method returns the number of lookups that were answered from the
+ cache since it was created.
+
+ @param
+ @return Count of the cache hits
+ */
+- (NSUInteger) getHits;
+
+/*!
+ This method returns the number of lookups that weren't in the cache - or
+ didn't have enough solutions to answer - since it was created.
+
+ @param
+ @return Count of the cache misses
+ */
+- (NSUInteger) getMisses;
+
+//----------------------------------------------------------------------------
+//					Initialization Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method initializes the cache to hold, at most, the provided number of
+ quips solved with the words in the words file, and if there's a path, to
+ load it from that file - if it's there, and a good one - and save it back
+ there.
+
+ @param capacity The most quips to hold on to
+ @param path The file to load and save the cache with, or nil
+ @param words The words file the quips are solved with, or nil
+ @return self
+ */
+- (id) initWithCapacity:(NSUInteger)capacity file:(NSString*)path wordsFile:(NSString*)words;
+
+//----------------------------------------------------------------------------
+//					Cache Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method looks up the quip in the cache, and if it's there, with enough
+ solutions to answer for the provided limit - or all the solutions, if the
+ limit is zero - this returns the legends of those solutions. They are the
+ legends for this cyphertext, so -decode: on them gives the plaintexts in
+ the case, and spacing, of the cyphertext. If the cache can't answer, this
+ returns nil.
+
+ @param text The cyphertext of the quip
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param limit The most solutions that are wanted, or zero for all of them
+ @return The array of Legends of the solutions, or nil
+ */
+- (NSArray*) solutionsForCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain limit:(NSUInteger)limit;
+
+/*!
+ This method adds the solutions for the quip to the cache - the legends of
+ them, as in -getSolutionKeys on the Quip that was solved with the limit.
+ If the search finished, and there are fewer solutions than the limit - or
+ the limit is zero - then these are all the solutions there are, and the
+ cache can answer for any limit. If it finished with the limit, it can only
+ answer for this limit, or less. But if the search was stopped before it
+ got to the end - it was cancelled, or ran out of time - then all we know
+ is that there are at least these, so it can only answer for that many.
+
+ @param legends The Legends of the solutions to the quip
+ @param text The cyphertext of the quip
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param limit The limit the quip was solved with, or zero for all of them
+ @param finished YES if the search ran to the end, or to the limit
+ */
+- (void) addSolutions:(id<NSFastEnumeration>)legends forCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain limit:(NSUInteger)limit finished:(BOOL)finished;
+
+/*!
+ This method writes the cache out to its file, if it has one, and returns
+ YES if it was written - or if there's no file to write.
+
+ @param
+ @return YES if the cache was saved
+ */
+- (BOOL) save;
+
+//----------------------------------------------------------------------------
+//					NSObject Overridden Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method makes sure to call the super's -init and then allocation all the
+ things we're going to need to function properly.
+ */
+- (id) init;
+
+/*!
+ This method returns a string that describes the contents of this guy in a
+ nice, human-readable format so that it's suitable for logging and debuggung.
+ */
+- (NSString*) description;
+
+@end
@@ -0,0 +1,428 @@
+//
+//  SolutionCache.m
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/16/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+
+// System Headers
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "SolutionCache_Protected.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Private Data Types
+
+// Private Constants
+#define SAVE_INTERVAL		64
+
+// Private Macros
+
+
+/*!
+ @class SolutionCache
+ This class is the cache of the solutions to the quips we've already seen,
+ so that a quip that comes around again doesn't have to be solved again.
+ Each quip is put in a canonical form first - the cypher letters renamed in
+ the order they first show up, the case folded, and the runs of spaces made
+ single spaces - along with the hint. That way the same quip, no matter
+ the key it was encyphered with, the capitalization, or the spacing, is
+ the same entry, and its solutions are kept as legends in that canonical
+ form, which are turned back into legends for the quip that was asked for.
+ They are kept sorted, so a smaller limit always gets the same ones. The
+ key has the identity of the words the solutions came from, too - the path
+ of the file, when it was last changed, and its size - so that a cache
+ file that's loaded with other words, or the same ones after an edit,
+ doesn't answer with solutions those words might not give.
+
+ The most recently used entries are kept, up to the capacity, and if the
+ cache was made with a file, it's loaded from there, and saved back to it
+ every so often, and on -save, so that it survives a restart. It's safe to
+ use from many threads at once.
+ */
+@implementation SolutionCache
+
+//----------------------------------------------------------------------------
+//					Creation Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method allows the caller to create an autoreleased SolutionCache that
+ holds, at most, the provided number of quips - in memory only.
+
+ @param capacity The most quips to hold on to
+ @return newly created SolutionCache
+ */
++ (SolutionCache*) createSolutionCache:(NSUInteger)capacity
+{
+	return [[SolutionCache alloc] initWithCapacity:capacity file:nil wordsFile:nil];
+}
+
+
+/*!
+ This method allows the caller to create an autoreleased SolutionCache that
+ holds, at most, the provided number of quips solved with the words in the
+ provided words file, and is loaded from, and saved to, the file at the
+ provided path.
+
+ @param capacity The most quips to hold on to
+ @param path The file to load and save the cache with
+ @param words The words file the quips are solved with
+ @return newly created SolutionCache
+ */
++ (SolutionCache*) createSolutionCache:(NSUInteger)capacity withFile:(NSString*)path forWordsFile:(NSString*)words
+{
+	return [[SolutionCache alloc] initWithCapacity:capacity file:path wordsFile:words];
+}
+
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the most quips this cache will hold on to.
+
+ @param
+ @return The capacity of the cache
+ */
+- (NSUInteger) getCapacity
+{
+	return _capacity;
+}
+
+
+/*!
+ This method returns the file this cache is loaded from, and saved to - or
+ nil if it's only in memory.
+
+ @param
+ @return The path of the file for the cache
+ */
+- (NSString*) getPath
+{
+	return _path;
+}
+
+
+/*!
+ This method returns the identity of the words the quips in this cache are
+ solved with - the path of the words file, when it was last changed, and
+ its size - or the empty string if it wasn't made with a words file.
+
+ @param
+ @return The identity of the words for the cache
+ */
+- (NSString*) getDictionary
+{
+	return _dictionary;
+}
+
+
+/*!
+ This method returns the number of quips in the cache right now.
+
+ @param
+ @return Count of quips in the cache
+ */
+- (NSUInteger) getCount
+{
+	NSUInteger	count = 0;
+	@synchronized(self) {
+		count = [[self getEntries] count];
+	}
+	return count;
+}
+
+
+/*!
+ This method returns the number of lookups that were answered from the
+ cache since it was created.
+
+ @param
+ @return Count of the cache hits
+ */
+- (NSUInteger) getHits
+{
+	return _hits;
+}
+
+
+/*!
+ This method returns the number of lookups that weren't in the cache - or
+ didn't have enough solutions to answer - since it was created.
+
+ @param
+ @return Count of the cache misses
+ */
+- (NSUInteger) getMisses
+{
+	return _misses;
+}
+
+
+//----------------------------------------------------------------------------
+//					Initialization Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method initializes the cache to hold, at most, the provided number of
+ quips solved with the words in the words file, and if there's a path, to
+ load it from that file - if it's there, and a good one - and save it back
+ there.
+
+ @param capacity The most quips to hold on to
+ @param path The file to load and save the cache with, or nil
+ @param words The words file the quips are solved with, or nil
+ @return self
+ */
+- (id) initWithCapacity:(NSUInteger)capacity file:(NSString*)path wordsFile:(NSString*)words
+{
+	if (self = [self init]) {
+		[self setCapacity:(capacity > 0 ? capacity : 1)];
+		[self setPath:path];
+		[self setDictionary:[SolutionCache identityOfWordsFile:words]];
+		// if there's a file, and it's a good one, start with what's in it
+		if (path != nil) {
+			NSDictionary*	saved = [NSDictionary dictionaryWithContentsOfFile:path];
+			if ((saved != nil) && ![SolutionCache isValidCache:saved]) {
+				NSLog(@"[SolutionCache -initWithCapacity:file:wordsFile:] - the cache in %@ isn't what was expected - a dictionary of quips to their solutions - and so it's not being used. It will be replaced the next time the cache is saved.", path);
+				saved = nil;
+			}
+			if (saved != nil) {
+				[[self getEntries] addEntriesFromDictionary:saved];
+				for (NSString* key in saved) {
+					[self touchEntry:key];
+				}
+				[self evictIfNeeded];
+			}
+		}
+	}
+	return self;
+}
+
+
+//----------------------------------------------------------------------------
+//					Cache Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method looks up the quip in the cache, and if it's there, with enough
+ solutions to answer for the provided limit - or all the solutions, if the
+ limit is zero - this returns the legends of those solutions. They are the
+ legends for this cyphertext, so -decode: on them gives the plaintexts in
+ the case, and spacing, of the cyphertext. If the cache can't answer, this
+ returns nil.
+
+ @param text The cyphertext of the quip
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param limit The most solutions that are wanted, or zero for all of them
+ @return The array of Legends of the solutions, or nil
+ */
+- (NSArray*) solutionsForCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain limit:(NSUInteger)limit
+{
+	NSMutableArray*	legends = nil;
+	unichar			rename[26];
+	NSString*		key = [self keyForCypherText:text where:cypher equals:plain renaming:rename];
+
+	// see if we have it, and if it has all the solutions that are wanted
+	NSArray*		canon = nil;
+	@synchronized(self) {
+		NSDictionary*	entry = [[self getEntries] objectForKey:key];
+		if (entry != nil) {
+			NSArray*	keys = [entry objectForKey:ENTRY_KEYS];
+			NSUInteger	most = [[entry objectForKey:ENTRY_LIMIT] unsignedIntegerValue];
+			if ([[entry objectForKey:ENTRY_COMPLETE] boolValue] ||
+				((limit > 0) && (limit <= most))) {
+				canon = keys;
+				if ((limit > 0) && ([keys count] > limit)) {
+					canon = [keys subarrayWithRange:NSMakeRange(0, limit)];
+				}
+				[self touchEntry:key];
+			}
+		}
+		if (canon != nil) {
+			++_hits;
+		} else {
+			++_misses;
+		}
+	}
+
+	/*
+	 Each canonical legend is the plain letter for each canonical cypher
+	 letter - or a '.' if it's not mapped - so undo the renaming to get
+	 back to the legend for this cyphertext.
+	 */
+	if (canon != nil) {
+		legends = [NSMutableArray arrayWithCapacity:[canon count]];
+		for (NSString* map in canon) {
+			Legend*		legend = [Legend createLegendWhere:cypher equals:plain];
+			for (unichar c = 'a'; c <= 'z'; ++c) {
+				unichar		k = rename[c - 'a'];
+				if ((k != '\0') && ((NSUInteger)(k - 'a') < [map length])) {
+					unichar		p = [map characterAtIndex:(k - 'a')];
+					if (p != '.') {
+						[legend mapCypherChar:c toPlainChar:p];
+					}
+				}
+			}
+			[legends addObject:legend];
+		}
+	}
+
+	return legends;
+}
+
+
+/*!
+ This method adds the solutions for the quip to the cache - the legends of
+ them, as in -getSolutionKeys on the Quip that was solved with the limit.
+ If the search finished, and there are fewer solutions than the limit - or
+ the limit is zero - then these are all the solutions there are, and the
+ cache can answer for any limit. If it finished with the limit, it can only
+ answer for this limit, or less. But if the search was stopped before it
+ got to the end - it was cancelled, or ran out of time - then all we know
+ is that there are at least these, so it can only answer for that many.
+
+ @param legends The Legends of the solutions to the quip
+ @param text The cyphertext of the quip
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param limit The limit the quip was solved with, or zero for all of them
+ @param finished YES if the search ran to the end, or to the limit
+ */
+- (void) addSolutions:(id<NSFastEnumeration>)legends forCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain limit:(NSUInteger)limit finished:(BOOL)finished
+{
+	unichar			rename[26];
+	NSString*		key = [self keyForCypherText:text where:cypher equals:plain renaming:rename];
+
+	// put each legend in the canonical form - a '.' for what's not mapped
+	NSMutableArray*	keys = [NSMutableArray array];
+	for (Legend* legend in legends) {
+		unichar		canon[26];
+		NSUInteger	len = 0;
+		for (NSUInteger i = 0; i < 26; ++i) {
+			canon[i] = '.';
+		}
+		for (unichar c = 'a'; c <= 'z'; ++c) {
+			unichar		k = rename[c - 'a'];
+			if (k != '\0') {
+				unichar		p = [legend plainCharForCypherChar:c];
+				canon[k - 'a'] = (p != '\0' ? p : '.');
+				if ((NSUInteger)(k - 'a') >= len) {
+					len = k - 'a' + 1;
+				}
+			}
+		}
+		[keys addObject:[NSString stringWithCharacters:canon length:len]];
+	}
+	// ...and in order, so that a smaller limit gets the same ones every time
+	[keys sortUsingSelector:@selector(compare:)];
+
+	/*
+	 If it finished with fewer than we asked for, then that's all there are,
+	 and if it was stopped short, it can only answer for the ones it found.
+	 */
+	BOOL			complete = (finished && ((limit == 0) || ([keys count] < limit)));
+	NSUInteger		most = (finished ? limit : [keys count]);
+	NSDictionary*	entry = [NSDictionary dictionaryWithObjectsAndKeys:
+								keys, ENTRY_KEYS,
+								[NSNumber numberWithUnsignedInteger:most], ENTRY_LIMIT,
+								[NSNumber numberWithBool:complete], ENTRY_COMPLETE,
+								nil];
+	BOOL			saveNow = NO;
+	@synchronized(self) {
+		// ...but a search that was stopped short never replaces a better one
+		NSDictionary*	old = [[self getEntries] objectForKey:key];
+		BOOL			keepOld = (!finished && (old != nil) &&
+								   ([[old objectForKey:ENTRY_COMPLETE] boolValue] ||
+									([[old objectForKey:ENTRY_LIMIT] unsignedIntegerValue] >= most)));
+		if (!keepOld && (finished || (most > 0))) {
+			[[self getEntries] setObject:entry forKey:key];
+			[self touchEntry:key];
+			[self evictIfNeeded];
+			if ((++_unsaved >= SAVE_INTERVAL) && ([self getPath] != nil)) {
+				saveNow = YES;
+			}
+		}
+	}
+	if (saveNow) {
+		[self save];
+	}
+}
+
+
+/*!
+ This method writes the cache out to its file, if it has one, and returns
+ YES if it was written - or if there's no file to write.
+
+ @param
+ @return YES if the cache was saved
+ */
+- (BOOL) save
+{
+	BOOL		error = NO;
+
+	// see if there's anything to do
+	if ([self getPath] != nil) {
+		@synchronized(self) {
+			if (![[self getEntries] writeToFile:[self getPath] atomically:YES]) {
+				error = YES;
+				NSLog(@"[SolutionCache -save] - the %lu quips in the cache could not be written to %@. Please make sure that the directory exists, and is writable, before saving to it.", (unsigned long)[[self getEntries] count], [self getPath]);
+			} else {
+				_unsaved = 0;
+			}
+		}
+	}
+
+	return !error;
+}
+
+
+//----------------------------------------------------------------------------
+//					NSObject Overridden Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method makes sure to call the super's -init and then allocation all the
+ things we're going to need to function properly.
+ */
+- (id) init
+{
+	if (self = [super init]) {
+		// make the dictionaries of the entries and when they were last used
+		_entries = [[NSMutableDictionary alloc] init];
+		_lastUsed = [[NSMutableDictionary alloc] init];
+		if ((_entries == nil) || (_lastUsed == nil)) {
+			NSLog(@"[SolutionCache -init] - the storage for the cached solutions could not be created. This is a serious allocation error and needs to be looked into as soon as possible.");
+		}
+	}
+	return self;
+}
+
+
+/*!
+ This method returns a string that describes the contents of this guy in a
+ nice, human-readable format so that it's suitable for logging and debuggung.
+ */
+- (NSString*) description
+{
+	NSString*	desc = nil;
+	@synchronized(self) {
+		desc = [NSString stringWithFormat:@"[SolutionCache quips:%lu/%lu, hits:%lu, misses:%lu, file:%@]", (unsigned long)[[self getEntries] count], (unsigned long)[self getCapacity], (unsigned long)_hits, (unsigned long)_misses, ([self getPath] != nil ? [self getPath] : @"none")];
+	}
+	return desc;
+}
+
+@end
@@ -0,0 +1,184 @@
+//
+//  SolutionCache_Protected.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/16/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+
+// System Headers
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "SolutionCache.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Protected Data Types
+
+// Protected Constants
+#define ENTRY_KEYS			@"keys"
+#define ENTRY_LIMIT			@"limit"
+#define ENTRY_COMPLETE		@"complete"
+
+// Protected Macros
+
+
+/*!
+ @category SolutionCache(Protected)
+ These are the 'protected' methods on the SolutionCache object. They are
+ protected as a category because they can do a lot more damage than good
+ in the wrong hands, but we want to keep everything well encapsulated so
+ we need these methods, we just don't want them in the public API that
+ everyone gets to see. So they are here.
+ */
+@interface SolutionCache (Protected)
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method sets the most quips this cache will hold on to.
+
+ @param capacity The capacity of the cache
+ */
+- (void) setCapacity:(NSUInteger)capacity;
+
+/*!
+ This method sets the file this cache is loaded from, and saved to - or
+ nil if it's only to be in memory.
+
+ @param path The path of the file for the cache
+ */
+- (void) setPath:(NSString*)path;
+
+/*!
+ This method sets the identity of the words the quips in this cache are
+ solved with - it's part of the key of every entry.
+
+ @param identity The identity of the words for the cache
+ */
+- (void) setDictionary:(NSString*)identity;
+
+/*!
+ This method sets the dictionary of the entries in the cache - each is
+ keyed by the canonical form of the quip and its hint, and is itself a
+ dictionary of the canonical legends of the solutions, and how complete
+ they are.
+
+ @param map Dictionary of canonical quips to their entries
+ */
+- (void) setEntries:(NSMutableDictionary*)map;
+
+/*!
+ This method returns the dictionary of the entries in the cache. It's the
+ real deal, so please be careful.
+
+ @param
+ @return Dictionary of canonical quips to their entries
+ */
+- (NSMutableDictionary*) getEntries;
+
+/*!
+ This method sets the dictionary of when each entry in the cache was last
+ used - by the tick of the cache at the time. It's how we know which ones
+ to let go of when the cache is full.
+
+ @param map Dictionary of canonical quips to the ticks they were last used
+ */
+- (void) setLastUsed:(NSMutableDictionary*)map;
+
+/*!
+ This method returns the dictionary of when each entry in the cache was
+ last used. It's the real deal, so please be careful.
+
+ @param
+ @return Dictionary of canonical quips to the ticks they were last used
+ */
+- (NSMutableDictionary*) getLastUsed;
+
+//----------------------------------------------------------------------------
+//					Cache Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the canonical form of the quip - the hint and the
+ cyphertext with the cypher letters renamed 'a', 'b', 'c', ... in the order
+ they first show up, the case folded, and the runs of spaces made into
+ single spaces, and trimmed off the ends. Only spaces, as that's all the
+ Quip splits the words on - a tab, or a newline, is part of a word, and
+ is kept just as it is. The renaming is filled in as
+ well - for each lowercase cypher letter, the canonical letter it became,
+ or '\0' if it's not in the quip - so it needs to have 26 elements.
+
+ @param text The cyphertext of the quip
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param rename The 26 element renaming of the cypher letters to fill in
+ @return The canonical form of the quip, to key the cache with
+ */
++ (NSString*) canonicalKeyForCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain renaming:(unichar*)rename;
+
+/*!
+ This method returns the key for the quip in this cache - the identity of
+ the words, and then the canonical form of the quip. The renaming is
+ filled in just as it is for -canonicalKeyForCypherText:where:equals:renaming:
+ so it needs to have 26 elements.
+
+ @param text The cyphertext of the quip
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param rename The 26 element renaming of the cypher letters to fill in
+ @return The key for the quip in the cache
+ */
+- (NSString*) keyForCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain renaming:(unichar*)rename;
+
+/*!
+ This method returns the identity of the words in the words file - its
+ full path, when it was last changed, and its size - so that if any of
+ them is different, so are the keys of the cache. If there's no file, or
+ it can't be looked at, this is the empty string, and the path if there
+ is one.
+
+ @param words The words file the quips are solved with, or nil
+ @return The identity of the words
+ */
++ (NSString*) identityOfWordsFile:(NSString*)words;
+
+/*!
+ This method returns YES if what was loaded from the cache file is what
+ we saved there - a dictionary of string keys, each to a dictionary with
+ the array of the canonical legends, as strings, and the numbers for the
+ limit and if they are complete. Anything else - a file that's been edited,
+ or is from something else altogether - isn't to be trusted, at all.
+
+ @param saved What was loaded from the cache file
+ @return YES if it's a cache we can use
+ */
++ (BOOL) isValidCache:(NSDictionary*)saved;
+
+/*!
+ This method marks the entry as just used, so that it's the last one to
+ be let go of when the cache is full.
+
+ @param key The canonical form of the quip
+ */
+- (void) touchEntry:(NSString*)key;
+
+/*!
+ This method lets go of the least recently used entries, if there are
+ more than the capacity. Rather than let go of just one every time, it
+ lets go of an eighth of the capacity at once, so that the sorting of the
+ entries by when they were last used isn't done very often at all.
+ */
+- (void) evictIfNeeded;
+
+@end
@@ -0,0 +1,323 @@
+//
+//  SolutionCache_Protected.m
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/16/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+
+// System Headers
+#include <ctype.h>
+#include <sys/stat.h>
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "SolutionCache_Protected.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Private Data Types
+
+// Private Constants
+
+// Private Macros
+
+
+/*!
+ @category SolutionCache(Protected)
+ These are the 'protected' methods on the SolutionCache object. They are
+ protected as a category because they can do a lot more damage than good
+ in the wrong hands, but we want to keep everything well encapsulated so
+ we need these methods, we just don't want them in the public API that
+ everyone gets to see. So they are here.
+ */
+@implementation SolutionCache (Protected)
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method sets the most quips this cache will hold on to.
+
+ @param capacity The capacity of the cache
+ */
+- (void) setCapacity:(NSUInteger)capacity
+{
+	_capacity = capacity;
+}
+
+
+/*!
+ This method sets the file this cache is loaded from, and saved to - or
+ nil if it's only to be in memory.
+
+ @param path The path of the file for the cache
+ */
+- (void) setPath:(NSString*)path
+{
+	_path = path;
+}
+
+
+/*!
+ This method sets the identity of the words the quips in this cache are
+ solved with - it's part of the key of every entry.
+
+ @param identity The identity of the words for the cache
+ */
+- (void) setDictionary:(NSString*)identity
+{
+	_dictionary = [identity copy];
+}
+
+
+/*!
+ This method sets the dictionary of the entries in the cache - each is
+ keyed by the canonical form of the quip and its hint, and is itself a
+ dictionary of the canonical legends of the solutions, and how complete
+ they are.
+
+ @param map Dictionary of canonical quips to their entries
+ */
+- (void) setEntries:(NSMutableDictionary*)map
+{
+	_entries = map;
+}
+
+
+/*!
+ This method returns the dictionary of the entries in the cache. It's the
+ real deal, so please be careful.
+
+ @param
+ @return Dictionary of canonical quips to their entries
+ */
+- (NSMutableDictionary*) getEntries
+{
+	return _entries;
+}
+
+
+/*!
+ This method sets the dictionary of when each entry in the cache was last
+ used - by the tick of the cache at the time. It's how we know which ones
+ to let go of when the cache is full.
+
+ @param map Dictionary of canonical quips to the ticks they were last used
+ */
+- (void) setLastUsed:(NSMutableDictionary*)map
+{
+	_lastUsed = map;
+}
+
+
+/*!
+ This method returns the dictionary of when each entry in the cache was
+ last used. It's the real deal, so please be careful.
+
+ @param
+ @return Dictionary of canonical quips to the ticks they were last used
+ */
+- (NSMutableDictionary*) getLastUsed
+{
+	return _lastUsed;
+}
+
+
+//----------------------------------------------------------------------------
+//					Cache Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the canonical form of the quip - the hint and the
+ cyphertext with the cypher letters renamed 'a', 'b', 'c', ... in the order
+ they first show up, the case folded, and the runs of spaces made into
+ single spaces, and trimmed off the ends. Only spaces, as that's all the
+ Quip splits the words on - a tab, or a newline, is part of a word, and
+ is kept just as it is. The renaming is filled in as
+ well - for each lowercase cypher letter, the canonical letter it became,
+ or '\0' if it's not in the quip - so it needs to have 26 elements.
+
+ @param text The cyphertext of the quip
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param rename The 26 element renaming of the cypher letters to fill in
+ @return The canonical form of the quip, to key the cache with
+ */
++ (NSString*) canonicalKeyForCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain renaming:(unichar*)rename
+{
+	NSUInteger	len = [text length];
+	unichar		buff[len + 4];
+	NSUInteger	out = 0;
+	unichar		next = 'a';
+	BOOL		space = NO;
+
+	for (NSUInteger i = 0; i < 26; ++i) {
+		rename[i] = '\0';
+	}
+	for (NSUInteger i = 0; i < len; ++i) {
+		unichar		c = [text characterAtIndex:i];
+		if (c == ' ') {
+			// runs of spaces are one space - but not at the start
+			space = (out > 0);
+		} else {
+			if (space) {
+				buff[out++] = ' ';
+				space = NO;
+			}
+			if ((c < 0x80) && isalpha(c)) {
+				// rename the letters in the order we first see them
+				c = tolower(c);
+				if (rename[c - 'a'] == '\0') {
+					rename[c - 'a'] = next++;
+				}
+				c = rename[c - 'a'];
+			}
+			buff[out++] = c;
+		}
+	}
+
+	// the hint's cypher letter might not be in the quip, but it's in the key
+	unichar		hint = ((cypher < 0x80) && isalpha(cypher) ? tolower(cypher) : '\0');
+	if ((hint != '\0') && (rename[hint - 'a'] == '\0')) {
+		rename[hint - 'a'] = next++;
+	}
+	return [NSString stringWithFormat:@"%C=%C\t%@", (unichar)(hint != '\0' ? rename[hint - 'a'] : '?'),
+				(unichar)(((plain < 0x80) && isalpha(plain)) ? tolower(plain) : '?'),
+				[NSString stringWithCharacters:buff length:out]];
+}
+
+
+/*!
+ This method returns the key for the quip in this cache - the identity of
+ the words, and then the canonical form of the quip. The renaming is
+ filled in just as it is for -canonicalKeyForCypherText:where:equals:renaming:
+ so it needs to have 26 elements.
+
+ @param text The cyphertext of the quip
+ @param cypher The cypher character that's part of the hint
+ @param plain The plain character that's part of the hint
+ @param rename The 26 element renaming of the cypher letters to fill in
+ @return The key for the quip in the cache
+ */
+- (NSString*) keyForCypherText:(NSString*)text where:(unichar)cypher equals:(unichar)plain renaming:(unichar*)rename
+{
+	NSString*	canon = [SolutionCache canonicalKeyForCypherText:text where:cypher equals:plain renaming:rename];
+	return [NSString stringWithFormat:@"%@\t%@", [self getDictionary], canon];
+}
+
+
+/*!
+ This method returns the identity of the words in the words file - its
+ full path, when it was last changed, and its size - so that if any of
+ them is different, so are the keys of the cache. If there's no file, or
+ it can't be looked at, this is the empty string, and the path if there
+ is one.
+
+ @param words The words file the quips are solved with, or nil
+ @return The identity of the words
+ */
++ (NSString*) identityOfWordsFile:(NSString*)words
+{
+	NSString*	identity = @"";
+	if (words != nil) {
+		NSString*	full = [words stringByStandardizingPath];
+		struct stat	st;
+		if (stat([full fileSystemRepresentation], &st) == 0) {
+			identity = [NSString stringWithFormat:@"%@@%lld:%lld", full, (long long)st.st_mtime, (long long)st.st_size];
+		} else {
+			identity = full;
+		}
+	}
+	return identity;
+}
+
+
+/*!
+ This method returns YES if what was loaded from the cache file is what
+ we saved there - a dictionary of string keys, each to a dictionary with
+ the array of the canonical legends, as strings, and the numbers for the
+ limit and if they are complete. Anything else - a file that's been edited,
+ or is from something else altogether - isn't to be trusted, at all.
+
+ @param saved What was loaded from the cache file
+ @return YES if it's a cache we can use
+ */
++ (BOOL) isValidCache:(NSDictionary*)saved
+{
+	BOOL		error = NO;
+
+	// it has to be a dictionary of strings to entries...
+	if (![saved isKindOfClass:[NSDictionary class]]) {
+		error = YES;
+	} else {
+		for (id key in saved) {
+			NSDictionary*	entry = [saved objectForKey:key];
+			if (![key isKindOfClass:[NSString class]] ||
+				![entry isKindOfClass:[NSDictionary class]] ||
+				![[entry objectForKey:ENTRY_KEYS] isKindOfClass:[NSArray class]] ||
+				![[entry objectForKey:ENTRY_LIMIT] isKindOfClass:[NSNumber class]] ||
+				![[entry objectForKey:ENTRY_COMPLETE] isKindOfClass:[NSNumber class]]) {
+				error = YES;
+			} else {
+				// ...and each entry's legends have to be strings
+				for (id legend in [entry objectForKey:ENTRY_KEYS]) {
+					if (![legend isKindOfClass:[NSString class]]) {
+						error = YES;
+						break;
+					}
+				}
+			}
+			if (error) {
+				break;
+			}
+		}
+	}
+
+	return !error;
+}
+
+
+/*!
+ This method marks the entry as just used, so that it's the last one to
+ be let go of when the cache is full.
+
+ @param key The canonical form of the quip
+ */
+- (void) touchEntry:(NSString*)key
+{
+	[[self getLastUsed] setObject:[NSNumber numberWithUnsignedInteger:++_tick] forKey:key];
+}
+
+
+/*!
+ This method lets go of the least recently used entries, if there are
+ more than the capacity. Rather than let go of just one every time, it
+ lets go of an eighth of the capacity at once, so that the sorting of the
+ entries by when they were last used isn't done very often at all.
+ */
+- (void) evictIfNeeded
+{
+	NSUInteger	count = [[self getEntries] count];
+	if (count > [self getCapacity]) {
+		// drop enough of the oldest to get an eighth under the capacity
+		NSUInteger	slack = [self getCapacity] / 8;
+		NSUInteger	drop = count - [self getCapacity] + slack;
+		NSArray*	oldest = [[self getLastUsed] keysSortedByValueUsingSelector:@selector(compare:)];
+		for (NSUInteger i = 0; (i < drop) && (i < [oldest count]); ++i) {
+			NSString*	key = [oldest objectAtIndex:i];
+			[[self getEntries] removeObjectForKey:key];
+			[[self getLastUsed] removeObjectForKey:key];
+		}
+	}
+}
+
+@end
@@ -0,0 +1,143 @@
+//
+//  WorkPool.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/8/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+#import <Foundation/Foundation.h>
+
+// System Headers
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Public Data Types
+/*!
+ This is what the WorkPool runs - a simple block with no arguments, and
+ anything it needs captured by the block itself.
+ */
+typedef void (^WorkPoolTask)(void);
+
+// Public Constants
+
+// Public Macros
+
+
+/*!
+ @class WorkPool
+ This class is a simple work-stealing thread pool. Each worker thread has
+ its own deque of tasks, and new tasks are dealt out to the deques round-
+ robin. A worker takes the newest task from its own deque, and when that's
+ empty, it steals the oldest task from one of the others. This keeps all
+ the cores busy even when the tasks are wildly different in size - as the
+ subtrees of a search usually are - without a single, contended, queue.
+ */
+@interface WorkPool : NSObject {
+@private
+	NSUInteger			_workerCount;
+	NSMutableArray*		_deques;
+	NSMutableArray*		_dequeLocks;
+	NSCondition*		_signal;
+	NSUInteger			_queued;
+	NSUInteger			_pending;
+	NSUInteger			_nextDeque;
+	BOOL				_shutdown;
+}
+
+//----------------------------------------------------------------------------
+//					Creation Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the shared WorkPool - with one worker for each active
+ core on the box. It's created the first time it's asked for, and is then
+ around for the life of the process.
+
+ @return The shared WorkPool
+ */
++ (WorkPool*) sharedWorkPool;
+
+/*!
+ This method allows the caller to create an autoreleased WorkPool with the
+ provided number of worker threads. If the count is zero, then there will
+ be one worker for each active core on the box. Remember to -shutdown the
+ pool when you're done with it, as the workers hold onto it.
+
+ @param count The number of worker threads, or zero for the core count
+ @return newly created WorkPool
+ */
++ (WorkPool*) createWorkPool:(NSUInteger)count;
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the number of worker threads in this pool.
+
+ @param
+ @return Count of worker threads
+ */
+- (NSUInteger) getWorkerCount;
+
+//----------------------------------------------------------------------------
+//					Initialization Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method initializes the pool with the provided number of worker
+ threads - or one for each active core, if the count is zero - and starts
+ them all up waiting for work.
+
+ @param count The number of worker threads, or zero for the core count
+ @return self
+ */
+- (id) initWithWorkerCount:(NSUInteger)count;
+
+//----------------------------------------------------------------------------
+//					Task Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method adds the task to the pool. It's placed on the next worker's
+ deque, and the workers are woken up to go get it. It's fine for a task
+ to add more tasks - they'll all be waited on by -waitUntilDone.
+
+ @param task The block to run on one of the workers
+ @return YES if the task was added, NO if the pool has been shut down
+ */
+- (BOOL) addTask:(WorkPoolTask)task;
+
+/*!
+ This method adds all the tasks to the pool and then waits for just those
+ tasks to be done. While it's waiting, the calling thread pitches in and
+ runs tasks too, so it's safe to call this from within a task - the pool
+ won't lock up with all the workers waiting on one another.
+
+ @param tasks The array of WorkPoolTask blocks to run
+ */
+- (void) runTasksAndWait:(NSArray*)tasks;
+
+/*!
+ This method waits until every task that's been added to the pool has been
+ run to completion - including the ones added by other tasks.
+ */
+- (void) waitUntilDone;
+
+/*!
+ This method tells all the workers to exit once the tasks already in the
+ pool are done. After this, no more tasks can be added.
+ */
+- (void) shutdown;
+
+@end
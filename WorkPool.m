@@ -0,0 +1,313 @@
+//
+//  WorkPool.m
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/8/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+
+// System Headers
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "WorkPool_Protected.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Private Data Types
+
+// Private Constants
+
+// Private Macros
+
+
+/*!
+ @class WorkPool
+ This class is a simple work-stealing thread pool. Each worker thread has
+ its own deque of tasks, and new tasks are dealt out to the deques round-
+ robin. A worker takes the newest task from its own deque, and when that's
+ empty, it steals the oldest task from one of the others. This keeps all
+ the cores busy even when the tasks are wildly different in size - as the
+ subtrees of a search usually are - without a single, contended, queue.
+ */
+@implementation WorkPool
+
+//----------------------------------------------------------------------------
+//					Creation Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the shared WorkPool - with one worker for each active
+ core on the box. It's created the first time it's asked for, and is then
+ around for the life of the process.
+
+ @return The shared WorkPool
+ */
++ (WorkPool*) sharedWorkPool
+{
+	static WorkPool*	__shared = nil;
+	@synchronized(self) {
+		if (__shared == nil) {
+			__shared = [[WorkPool alloc] initWithWorkerCount:0];
+		}
+	}
+	return __shared;
+}
+
+
+/*!
+ This method allows the caller to create an autoreleased WorkPool with the
+ provided number of worker threads. If the count is zero, then there will
+ be one worker for each active core on the box. Remember to -shutdown the
+ pool when you're done with it, as the workers hold onto it.
+
+ @param count The number of worker threads, or zero for the core count
+ @return newly created WorkPool
+ */
++ (WorkPool*) createWorkPool:(NSUInteger)count
+{
+	// create what we said we would - this is just a convenience method
+	return [[WorkPool alloc] initWithWorkerCount:count];
+}
+
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the number of worker threads in this pool.
+
+ @param
+ @return Count of worker threads
+ */
+- (NSUInteger) getWorkerCount
+{
+	return _workerCount;
+}
+
+
+//----------------------------------------------------------------------------
+//					Initialization Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method initializes the pool with the provided number of worker
+ threads - or one for each active core, if the count is zero - and starts
+ them all up waiting for work.
+
+ @param count The number of worker threads, or zero for the core count
+ @return self
+ */
+- (id) initWithWorkerCount:(NSUInteger)count
+{
+	if (self = [self init]) {
+		// see how many workers we really need to have
+		if (count == 0) {
+			count = [[NSProcessInfo processInfo] activeProcessorCount];
+		}
+		if (count == 0) {
+			count = 1;
+		}
+		_workerCount = count;
+		// each worker gets a deque, and a lock to guard it
+		for (NSUInteger i = 0; i < count; ++i) {
+			[[self getDeques] addObject:[NSMutableArray array]];
+			[[self getDequeLocks] addObject:[[NSLock alloc] init]];
+		}
+		// ...and now we can start them all up
+		for (NSUInteger i = 0; i < count; ++i) {
+			[NSThread detachNewThreadSelector:@selector(runWorker:) toTarget:self withObject:[NSNumber numberWithUnsignedInteger:i]];
+		}
+	}
+	return self;
+}
+
+
+//----------------------------------------------------------------------------
+//					Task Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method adds the task to the pool. It's placed on the next worker's
+ deque, and the workers are woken up to go get it. It's fine for a task
+ to add more tasks - they'll all be waited on by -waitUntilDone.
+
+ @param task The block to run on one of the workers
+ @return YES if the task was added, NO if the pool has been shut down
+ */
+- (BOOL) addTask:(WorkPoolTask)task
+{
+	BOOL		error = NO;
+
+	// see if there's anything to do
+	if (!error) {
+		if (task == nil) {
+			error = YES;
+			NSLog(@"[WorkPool -addTask:] - the passed-in task is nil and that really means that there's nothing for me to do. Please make sure the argument to this method is not nil before calling.");
+		}
+	}
+
+	// see if we're still taking work
+	NSUInteger	slot = 0;
+	if (!error) {
+		[[self getSignal] lock];
+		if (_shutdown) {
+			error = YES;
+		} else {
+			slot = _nextDeque;
+			_nextDeque = (_nextDeque + 1) % _workerCount;
+			++_pending;
+			++_queued;
+		}
+		[[self getSignal] unlock];
+		if (error) {
+			NSLog(@"[WorkPool -addTask:] - the pool has been shut down, and so there are no workers left to run this task. Please make sure to only add tasks to a running pool.");
+		}
+	}
+
+	// put it at the back of the deque, and let the workers know it's there
+	if (!error) {
+		NSLock*		lock = [[self getDequeLocks] objectAtIndex:slot];
+		[lock lock];
+		[[[self getDeques] objectAtIndex:slot] addObject:[task copy]];
+		[lock unlock];
+		[[self getSignal] lock];
+		[[self getSignal] broadcast];
+		[[self getSignal] unlock];
+	}
+
+	return !error;
+}
+
+
+/*!
+ This method adds all the tasks to the pool and then waits for just those
+ tasks to be done. While it's waiting, the calling thread pitches in and
+ runs tasks too, so it's safe to call this from within a task - the pool
+ won't lock up with all the workers waiting on one another.
+
+ @param tasks The array of WorkPoolTask blocks to run
+ */
+- (void) runTasksAndWait:(NSArray*)tasks
+{
+	// each task counts itself down when it's done
+	NSCondition*		done = [[NSCondition alloc] init];
+	__block NSUInteger	remaining = [tasks count];
+	for (WorkPoolTask task in tasks) {
+		WorkPoolTask	counted = ^{
+			task();
+			[done lock];
+			if (--remaining == 0) {
+				[done broadcast];
+			}
+			[done unlock];
+		};
+		// if the pool isn't taking work, then we'll just do it ourselves
+		if (![self addTask:counted]) {
+			counted();
+		}
+	}
+
+	// help out while we wait - stealing is all we can do, we have no deque
+	while (YES) {
+		[done lock];
+		BOOL	finished = (remaining == 0);
+		[done unlock];
+		if (finished) {
+			break;
+		}
+		WorkPoolTask	task = [self takeTaskForWorker:_workerCount];
+		if (task != nil) {
+			task();
+			[[self getSignal] lock];
+			if (--_pending == 0) {
+				[[self getSignal] broadcast];
+			}
+			[[self getSignal] unlock];
+		} else {
+			// nothing to steal, so wait a bit for the rest to finish up
+			[done lock];
+			if (remaining > 0) {
+				[done waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.005]];
+			}
+			[done unlock];
+		}
+	}
+}
+
+
+/*!
+ This method waits until every task that's been added to the pool has been
+ run to completion - including the ones added by other tasks.
+ */
+- (void) waitUntilDone
+{
+	[[self getSignal] lock];
+	while (_pending > 0) {
+		[[self getSignal] wait];
+	}
+	[[self getSignal] unlock];
+}
+
+
+/*!
+ This method tells all the workers to exit once the tasks already in the
+ pool are done. After this, no more tasks can be added.
+ */
+- (void) shutdown
+{
+	[[self getSignal] lock];
+	_shutdown = YES;
+	[[self getSignal] broadcast];
+	[[self getSignal] unlock];
+}
+
+
+//----------------------------------------------------------------------------
+//					NSObject Overridden Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method makes sure to call the super's -init and then allocation all the
+ things we're going to need to function properly.
+ */
+- (id) init
+{
+	if (self = [super init]) {
+		// make the deques and their locks - the workers will fill them in
+		_deques = [[NSMutableArray alloc] init];
+		_dequeLocks = [[NSMutableArray alloc] init];
+		if ((_deques == nil) || (_dequeLocks == nil)) {
+			NSLog(@"[WorkPool -init] - the storage for the task deques could not be created. This is a serious allocation error and needs to be looked into as soon as possible.");
+		}
+		// ...and the condition the idle workers will wait on
+		_signal = [[NSCondition alloc] init];
+		if (_signal == nil) {
+			NSLog(@"[WorkPool -init] - the condition for the idle workers could not be created. This is a serious allocation error and needs to be looked into as soon as possible.");
+		}
+	}
+	return self;
+}
+
+
+/*!
+ This method returns a string that describes the contents of this guy in a
+ nice, human-readable format so that it's suitable for logging and debuggung.
+ */
+- (NSString*) description
+{
+	[[self getSignal] lock];
+	NSString*	desc = [NSString stringWithFormat:@"[WorkPool workers:%lu, queued:%lu, pending:%lu%s]", (unsigned long)_workerCount, (unsigned long)_queued, (unsigned long)_pending, (_shutdown ? ", shutdown" : "")];
+	[[self getSignal] unlock];
+	return desc;
+}
+
+@end
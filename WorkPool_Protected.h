@@ -0,0 +1,98 @@
+//
+//  WorkPool_Protected.h
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/8/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+
+// System Headers
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "WorkPool.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Protected Data Types
+
+// Protected Constants
+
+// Protected Macros
+
+
+/*!
+ @category WorkPool(Protected)
+ These are the 'protected' methods on the WorkPool object. They are
+ protected as a category because they can do a lot more damage than good
+ in the wrong hands, but we want to keep everything well encapsulated so
+ we need these methods, we just don't want them in the public API that
+ everyone gets to see. So they are here.
+ */
+@interface WorkPool (Protected)
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the array of task deques - one per worker. Each is an
+ NSMutableArray with the oldest task at the front, and is only to be
+ touched while holding the matching lock from -getDequeLocks.
+
+ @param
+ @return The array of task deques
+ */
+- (NSMutableArray*) getDeques;
+
+/*!
+ This method returns the array of locks - one per deque - that guard the
+ deques from the owner and the thieves at the same time.
+
+ @param
+ @return The array of deque locks
+ */
+- (NSMutableArray*) getDequeLocks;
+
+/*!
+ This method returns the condition that the idle workers wait on, and that
+ guards the counts of the queued and pending tasks.
+
+ @param
+ @return The condition for the idle workers and the counts
+ */
+- (NSCondition*) getSignal;
+
+//----------------------------------------------------------------------------
+//					Worker Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method tries to get the next task for the worker at the index. It
+ takes the newest from the worker's own deque, and failing that, steals the
+ oldest from the others. If there's nothing anywhere, it returns nil. A
+ thread that's not one of the workers - like one waiting in -runTasksAndWait:
+ - passes an index past the last worker, and only ever steals.
+
+ @param index The zero-biased index of the worker looking for work
+ @return The task to run, or nil if there is none
+ */
+- (WorkPoolTask) takeTaskForWorker:(NSUInteger)index;
+
+/*!
+ This is the main loop of each worker thread. It runs tasks as long as it
+ can find them, and waits for more when it can't, until the pool is shut
+ down and there's nothing left to do.
+
+ @param index The zero-biased index of this worker, as an NSNumber
+ */
+- (void) runWorker:(NSNumber*)index;
+
+@end
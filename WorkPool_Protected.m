@@ -0,0 +1,178 @@
+//
+//  WorkPool_Protected.m
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/8/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+
+// System Headers
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "WorkPool_Protected.h"
+
+// Superclass Headers
+
+// Forward Class Declarations
+
+// Private Data Types
+
+// Private Constants
+
+// Private Macros
+
+
+/*!
+ @category WorkPool(Protected)
+ These are the 'protected' methods on the WorkPool object. They are
+ protected as a category because they can do a lot more damage than good
+ in the wrong hands, but we want to keep everything well encapsulated so
+ we need these methods, we just don't want them in the public API that
+ everyone gets to see. So they are here.
+ */
+@implementation WorkPool (Protected)
+
+//----------------------------------------------------------------------------
+//					Accessor Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method returns the array of task deques - one per worker. Each is an
+ NSMutableArray with the oldest task at the front, and is only to be
+ touched while holding the matching lock from -getDequeLocks.
+
+ @param
+ @return The array of task deques
+ */
+- (NSMutableArray*) getDeques
+{
+	return _deques;
+}
+
+
+/*!
+ This method returns the array of locks - one per deque - that guard the
+ deques from the owner and the thieves at the same time.
+
+ @param
+ @return The array of deque locks
+ */
+- (NSMutableArray*) getDequeLocks
+{
+	return _dequeLocks;
+}
+
+
+/*!
+ This method returns the condition that the idle workers wait on, and that
+ guards the counts of the queued and pending tasks.
+
+ @param
+ @return The condition for the idle workers and the counts
+ */
+- (NSCondition*) getSignal
+{
+	return _signal;
+}
+
+
+//----------------------------------------------------------------------------
+//					Worker Methods
+//----------------------------------------------------------------------------
+
+/*!
+ This method tries to get the next task for the worker at the index. It
+ takes the newest from the worker's own deque, and failing that, steals the
+ oldest from the others. If there's nothing anywhere, it returns nil. A
+ thread that's not one of the workers - like one waiting in -runTasksAndWait:
+ - passes an index past the last worker, and only ever steals.
+
+ @param index The zero-biased index of the worker looking for work
+ @return The task to run, or nil if there is none
+ */
+- (WorkPoolTask) takeTaskForWorker:(NSUInteger)index
+{
+	WorkPoolTask	task = nil;
+	NSUInteger		count = [self getWorkerCount];
+
+	// first, try the newest task on our own deque
+	if (index < count) {
+		NSLock*			lock = [[self getDequeLocks] objectAtIndex:index];
+		NSMutableArray*	deque = [[self getDeques] objectAtIndex:index];
+		[lock lock];
+		if ([deque count] > 0) {
+			task = [deque lastObject];
+			[deque removeLastObject];
+		}
+		[lock unlock];
+	}
+
+	// ...then go around the others, stealing the oldest from the first we can
+	for (NSUInteger i = 1; (task == nil) && (i <= count); ++i) {
+		NSUInteger		victim = (index + i) % count;
+		if (victim == index) {
+			continue;
+		}
+		NSLock*			lock = [[self getDequeLocks] objectAtIndex:victim];
+		NSMutableArray*	deque = [[self getDeques] objectAtIndex:victim];
+		[lock lock];
+		if ([deque count] > 0) {
+			task = [deque objectAtIndex:0];
+			[deque removeObjectAtIndex:0];
+		}
+		[lock unlock];
+	}
+
+	// if we got one, it's no longer waiting to be picked up
+	if (task != nil) {
+		[[self getSignal] lock];
+		--_queued;
+		[[self getSignal] unlock];
+	}
+
+	return task;
+}
+
+
+/*!
+ This is the main loop of each worker thread. It runs tasks as long as it
+ can find them, and waits for more when it can't, until the pool is shut
+ down and there's nothing left to do.
+
+ @param index The zero-biased index of this worker, as an NSNumber
+ */
+- (void) runWorker:(NSNumber*)index
+{
+	NSUInteger		me = [index unsignedIntegerValue];
+	BOOL			done = NO;
+	while (!done) {
+		@autoreleasepool {
+			WorkPoolTask	task = [self takeTaskForWorker:me];
+			if (task != nil) {
+				task();
+				// ...and let anyone waiting know if that was the last of them
+				[[self getSignal] lock];
+				if (--_pending == 0) {
+					[[self getSignal] broadcast];
+				}
+				[[self getSignal] unlock];
+			} else {
+				// nothing anywhere, so wait for something to be added
+				[[self getSignal] lock];
+				while ((_queued == 0) && !_shutdown) {
+					[[self getSignal] wait];
+				}
+				done = (_shutdown && (_queued == 0));
+				[[self getSignal] unlock];
+			}
+		}
+	}
+}
+
+@end
@@ -0,0 +1,91 @@
+//
+//  mkquipdict.c
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/2/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// System Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Other Headers
+#include "QuipDict.h"
+
+
+/*
+ * This is the build-time tool that compiles a list of plaintext words -
+ * one to a line - into the binary image that the solver can simply mmap.
+ * By default, it only rebuilds the image if the word list has changed since
+ * it was last built, so it's safe to run as part of every build:
+ *
+ *   mkquipdict [-f] [-v] words [words.qdict]
+ *
+ * where '-f' forces the rebuild, and '-v' verifies the complete image and
+ * reports what's in it.
+ */
+int main(int argc, char* argv[])
+{
+	int		force = 0;
+	int		verbose = 0;
+	int		opt;
+	while ((opt = getopt(argc, argv, "fv")) != -1) {
+		switch (opt) {
+			case 'f':
+				force = 1;
+				break;
+			case 'v':
+				verbose = 1;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-f] [-v] words [words.qdict]\n", argv[0]);
+				return 2;
+		}
+	}
+	if ((optind >= argc) || (argc - optind > 2)) {
+		fprintf(stderr, "usage: %s [-f] [-v] words [words.qdict]\n", argv[0]);
+		return 2;
+	}
+
+	// the output defaults to the source with the '.qdict' extension
+	const char*	src = argv[optind];
+	char		dflt[strlen(src) + 7];
+	snprintf(dflt, sizeof(dflt), "%s.qdict", src);
+	const char*	dst = (argc - optind > 1 ? argv[optind + 1] : dflt);
+
+	// only build it if we have to
+	if (force || !qd_is_current(dst, src)) {
+		int		error = qd_build_file(src, dst);
+		if (error != 0) {
+			fprintf(stderr, "%s: unable to build %s from %s: %s\n", argv[0], dst, src, strerror(error));
+			return 1;
+		}
+		if (verbose) {
+			printf("built %s from %s\n", dst, src);
+		}
+	} else if (verbose) {
+		printf("%s is up to date with %s\n", dst, src);
+	}
+
+	// if they want to know, tell them all about it
+	if (verbose) {
+		QDImage		img;
+		int			error = qd_open(&img, dst);
+		if (error == 0) {
+			error = qd_verify(&img);
+		}
+		if (error != 0) {
+			fprintf(stderr, "%s: %s is not a valid image: %s\n", argv[0], dst, strerror(error));
+			return 1;
+		}
+		printf("%s: %u words in %u patterns, %u byte arena, longest word %u, %zu bytes total\n",
+			   dst, img.header->wordCount, img.header->bucketCount, img.header->arenaSize,
+			   img.header->maxWordLength, img.size);
+		qd_close(&img);
+	}
+
+	return 0;
+}
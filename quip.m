@@ -0,0 +1,264 @@
+//
+//  quip.m
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/4/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+#import <Foundation/Foundation.h>
+
+// System Headers
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Third Party Headers
+
+// Other Headers
+#include "MatchKernel.h"
+
+// Class Headers
+#import "Quip.h"
+#import "PatternIndex.h"
+#import "SolutionCache.h"
+
+// Private Constants
+#define DEFAULT_WORDS	"words"
+#define CACHE_CAPACITY	10000
+
+
+/*
+ * This is the headless, command-line, solver. It only needs the solver
+ * classes and Foundation, so it builds on Linux with GNUstep as well as on
+ * the Mac, and it's what we use for batch solving. It can be given a single
+ * puzzle on the command line:
+ *
+ *   quip [-p] [-o] [-f] [-n limit] [-C cache] [-w words] [-d words.qdict] b=t 'Fict O ncc bivteclnbklzn O lcpji ukl pt vzglcddp'
+ *
+ * or, with no puzzle, it'll read one puzzle per line from stdin, each in
+ * the same form - the hint, whitespace, and then the cyphertext. Blank lines
+ * and lines starting with '#' are skipped. For each puzzle, the solutions
+ * and the timings are written to stdout as tab-separated lines:
+ *
+ *   solution <n> <plaintext>
+ *   timing <n> setup_ms=<ms> solve_ms=<ms> solutions=<count>
+ *   stats <n> nodes=<count> depth=<max> ...
+ *
+ * where the 'stats' line is only there if the solver was built with
+ * QUIP_INSTRUMENTATION defined - 'make instrument=yes'.
+ *
+ * and stdout is flushed after each solution, and each puzzle, so that they
+ * stream out as they are found. Only the first solution is looked for,
+ * unless '-n' says how many to look for - with zero meaning all of them.
+ *
+ * With '-p' each puzzle is solved with the parallel attack, on all the
+ * cores of the box, with '-o' the words are tried with the most constrained
+ * one first at each step of the search, and with '-f' each word tried
+ * narrows the possibles of all the rest - these can be combined.
+ *
+ * With '-C' the solutions are kept in the cache file, and a puzzle that's
+ * already in there - even encyphered with a different key - is answered
+ * from it rather than solved again. The timing line then ends with
+ * 'cache=hit' or 'cache=miss', and the hits and misses for the run are the
+ * last line:
+ *
+ *   cache hits=<count> misses=<count> entries=<count>
+ */
+
+
+/*
+ * This function parses the hint - something like 'b=t' - into the cypher
+ * and plain characters, and returns YES if it's a valid hint.
+ */
+static BOOL parseHint(const char* hint, unichar* cypher, unichar* plain)
+{
+	BOOL	ok = NO;
+	if ((hint != NULL) && (strlen(hint) == 3) && (hint[1] == '=') &&
+		isalpha((unsigned char)hint[0]) && isalpha((unsigned char)hint[2])) {
+		*cypher = tolower((unsigned char)hint[0]);
+		*plain = tolower((unsigned char)hint[2]);
+		ok = YES;
+	}
+	return ok;
+}
+
+
+/*
+ * This function solves the one puzzle, and writes out the solutions and
+ * the timings for it. It returns YES if there was at least one solution.
+ */
+static BOOL solvePuzzle(PatternIndex* index, SolutionCache* cache, NSUInteger num, NSString* cyphertext, unichar cypher, unichar plain, QuipAttackOptions options, NSUInteger limit)
+{
+	BOOL	solved = NO;
+	@autoreleasepool {
+		// see if we've already done this one - in any of its disguises
+		NSTimeInterval	start = [NSDate timeIntervalSinceReferenceDate];
+		NSArray*		cached = [cache solutionsForCypherText:cyphertext where:cypher equals:plain limit:limit];
+		if (cached != nil) {
+			for (Legend* legend in cached) {
+				printf("solution\t%lu\t%s\n", (unsigned long)num, [[legend decode:cyphertext] UTF8String]);
+			}
+			printf("timing\t%lu\tsetup_ms=%.3f\tsolve_ms=%.3f\tsolutions=%lu\tcache=hit\n",
+				   (unsigned long)num, 0.0, ([NSDate timeIntervalSinceReferenceDate] - start) * 1000,
+				   (unsigned long)[cached count]);
+			fflush(stdout);
+			return ([cached count] > 0);
+		}
+
+		NSTimeInterval	begin = [NSDate timeIntervalSinceReferenceDate];
+		Quip*			q = [[Quip alloc] initWithCypherText:cyphertext where:cypher equals:plain usingIndex:index];
+		NSTimeInterval	built = [NSDate timeIntervalSinceReferenceDate];
+		solved = [q attemptWordBlockAttackWithOptions:options limit:limit solutionHandler:^(Legend* legend, NSString* plaintext) {
+			printf("solution\t%lu\t%s\n", (unsigned long)num, [plaintext UTF8String]);
+			fflush(stdout);
+		}];
+		NSTimeInterval	done = [NSDate timeIntervalSinceReferenceDate];
+
+		// ...one that got to its limit was cancelled, but it still finished
+		BOOL			finished = (![q isCancelled] || ((limit > 0) && ([[q getSolutions] count] >= limit)));
+		[cache addSolutions:[q getSolutionKeys] forCypherText:cyphertext where:cypher equals:plain limit:limit finished:finished];
+
+		printf("timing\t%lu\tsetup_ms=%.3f\tsolve_ms=%.3f\tsolutions=%lu%s\n",
+			   (unsigned long)num, (built - begin) * 1000, (done - built) * 1000,
+			   (unsigned long)[[q getSolutions] count], (cache != nil ? "\tcache=miss" : ""));
+		// ...and the statistics, if the solver is keeping them
+		if ([q getStatisticsSummary] != nil) {
+			printf("stats\t%lu\t%s\n", (unsigned long)num,
+				   [[[q getStatisticsSummary] stringByReplacingOccurrencesOfString:@" " withString:@"\t"] UTF8String]);
+		}
+		fflush(stdout);
+	}
+	return solved;
+}
+
+
+int main(int argc, char* argv[])
+{
+	int		retval = 0;
+	@autoreleasepool {
+		const char*		words = DEFAULT_WORDS;
+		const char*		dict = NULL;
+		const char*		cacheFile = NULL;
+		QuipAttackOptions	options = QuipAttackSerial;
+		NSUInteger		limit = 1;
+		int				opt;
+		while ((opt = getopt(argc, argv, "pofn:C:w:d:")) != -1) {
+			switch (opt) {
+				case 'p':
+					options |= QuipAttackParallel;
+					break;
+				case 'o':
+					options |= QuipAttackDynamicOrder;
+					break;
+				case 'f':
+					options |= QuipAttackForwardCheck;
+					break;
+				case 'n':
+					limit = (NSUInteger)strtoul(optarg, NULL, 10);
+					break;
+				case 'C':
+					cacheFile = optarg;
+					break;
+				case 'w':
+					words = optarg;
+					break;
+				case 'd':
+					dict = optarg;
+					break;
+				default:
+					fprintf(stderr, "usage: %s [-p] [-o] [-f] [-n limit] [-C cache] [-w words] [-d words.qdict] [hint cyphertext]\n", argv[0]);
+					return 2;
+			}
+		}
+
+		// load up the words - compiling them if we need to
+		NSString*		wordsFile = [NSString stringWithUTF8String:words];
+		NSString*		dictFile = (dict != NULL ? [NSString stringWithUTF8String:dict] :
+									[wordsFile stringByAppendingPathExtension:@"qdict"]);
+		NSTimeInterval	begin = [NSDate timeIntervalSinceReferenceDate];
+		PatternIndex*	index = [PatternIndex createPatternIndexForWordsFile:wordsFile compiledTo:dictFile];
+		if (index == nil) {
+			fprintf(stderr, "%s: unable to load the words from %s\n", argv[0], words);
+			return 1;
+		}
+		printf("dictionary\t%s\twords=%lu\tload_ms=%.3f\tfilter=%s\n", [dictFile UTF8String],
+			   (unsigned long)[index getWordCount], ([NSDate timeIntervalSinceReferenceDate] - begin) * 1000,
+			   mk_filter_name());
+		fflush(stdout);
+
+		// ...and the cache of what we've solved before, if we're keeping one
+		SolutionCache*	cache = nil;
+		if (cacheFile != NULL) {
+			cache = [SolutionCache createSolutionCache:CACHE_CAPACITY withFile:[NSString stringWithUTF8String:cacheFile] forWordsFile:wordsFile];
+		}
+
+		unichar		cypher = '\0';
+		unichar		plain = '\0';
+		if (optind < argc) {
+			// it's a single puzzle on the command line
+			if ((argc - optind != 2) || !parseHint(argv[optind], &cypher, &plain)) {
+				fprintf(stderr, "usage: %s [-p] [-o] [-f] [-n limit] [-C cache] [-w words] [-d words.qdict] [hint cyphertext]\n", argv[0]);
+				return 2;
+			}
+			if (!solvePuzzle(index, cache, 1, [NSString stringWithUTF8String:argv[optind + 1]], cypher, plain, options, limit)) {
+				retval = 1;
+			}
+		} else {
+			// it's one puzzle per line on stdin
+			char*		line = NULL;
+			size_t		cap = 0;
+			ssize_t		len;
+			NSUInteger	num = 0;
+			while ((len = getline(&line, &cap, stdin)) > 0) {
+				// trim off the line ending, and skip the blanks and comments
+				while ((len > 0) && isspace((unsigned char)line[len - 1])) {
+					line[--len] = '\0';
+				}
+				char*	hint = line;
+				while (isspace((unsigned char)*hint)) {
+					++hint;
+				}
+				if ((*hint == '\0') || (*hint == '#')) {
+					continue;
+				}
+				++num;
+				// split the hint from the cyphertext
+				char*	text = hint;
+				while ((*text != '\0') && !isspace((unsigned char)*text)) {
+					++text;
+				}
+				if (*text != '\0') {
+					*text++ = '\0';
+				}
+				while (isspace((unsigned char)*text)) {
+					++text;
+				}
+				if (!parseHint(hint, &cypher, &plain) || (*text == '\0')) {
+					printf("error\t%lu\tunable to parse the puzzle\n", (unsigned long)num);
+					fflush(stdout);
+					retval = 1;
+					continue;
+				}
+				if (!solvePuzzle(index, cache, num, [NSString stringWithUTF8String:text], cypher, plain, options, limit)) {
+					retval = 1;
+				}
+			}
+			free(line);
+		}
+
+		// save what we've learned for next time
+		if (cache != nil) {
+			if (![cache save]) {
+				fprintf(stderr, "%s: unable to save the cache to %s\n", argv[0], cacheFile);
+			}
+			printf("cache\thits=%lu\tmisses=%lu\tentries=%lu\n", (unsigned long)[cache getHits],
+				   (unsigned long)[cache getMisses], (unsigned long)[cache getCount]);
+			fflush(stdout);
+		}
+	}
+	return retval;
+}
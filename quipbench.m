@@ -0,0 +1,281 @@
+//
+//  quipbench.m
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/14/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+#import <Foundation/Foundation.h>
+
+// System Headers
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Third Party Headers
+
+// Other Headers
+#include "MatchKernel.h"
+
+// Class Headers
+#import "Quip.h"
+#import "PatternIndex.h"
+
+// Private Constants
+#define DEFAULT_WORDS		"words"
+#define DEFAULT_CORPUS		"bench.quips"
+#define DEFAULT_REPEATS		5
+
+
+/*
+ * This is the benchmark for the solver. It runs every quip in the corpus -
+ * a file of one quip to a line, as the hint, the cyphertext and the known
+ * plaintext, separated by tabs - a number of times, and times each of the
+ * phases of the solve on its own:
+ *
+ *   load     - loading the dictionary, done once
+ *   setup    - making the Quip, its pieces, and filling in their possibles
+ *   prepare  - sorting the pieces, coding their possibles, and with -f,
+ *              building the tables of the pairs of pieces
+ *   search   - the search itself
+ *
+ * When it's done, it writes the median and 99th percentile of each, the
+ * nodes per second of the search, and how many quips came out right, as
+ * JSON on stdout - so it's easy to keep the results of each release, and
+ * compare them to catch a regression in the solver:
+ *
+ *   quipbench [-p] [-o] [-f] [-r repeats] [-c bench.quips] [-w words] [-d words.qdict]
+ *
+ * The attack options are the same as for 'quip'.
+ */
+
+
+/*
+ * This function parses the hint - something like 'b=t' - into the cypher
+ * and plain characters, and returns YES if it's a valid hint.
+ */
+static BOOL parseHint(NSString* hint, unichar* cypher, unichar* plain)
+{
+	BOOL	ok = NO;
+	if (([hint length] == 3) && ([hint characterAtIndex:1] == '=') &&
+		([hint characterAtIndex:0] < 0x80) && isalpha([hint characterAtIndex:0]) &&
+		([hint characterAtIndex:2] < 0x80) && isalpha([hint characterAtIndex:2])) {
+		*cypher = tolower([hint characterAtIndex:0]);
+		*plain = tolower([hint characterAtIndex:2]);
+		ok = YES;
+	}
+	return ok;
+}
+
+
+/*
+ * This function sorts the times so that the percentiles can be picked off
+ * the top of them.
+ */
+static int compareTimes(const void* a, const void* b)
+{
+	double	x = *(const double*)a;
+	double	y = *(const double*)b;
+	return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+
+/*
+ * This function writes out the JSON object for the one phase - the median,
+ * the 99th percentile and the total of the 'count' times, in msec. The
+ * times are sorted in place. The percentiles are by nearest rank.
+ */
+static void printPhase(const char* name, double* times, NSUInteger count, BOOL last)
+{
+	double		total = 0.0;
+	double		median = 0.0;
+	double		p99 = 0.0;
+	if (count > 0) {
+		qsort(times, count, sizeof(double), compareTimes);
+		for (NSUInteger i = 0; i < count; ++i) {
+			total += times[i];
+		}
+		median = times[(count - 1) / 2];
+		p99 = times[(count * 99 + 99) / 100 - 1];
+	}
+	printf("    \"%s\": { \"median_ms\": %.4f, \"p99_ms\": %.4f, \"total_ms\": %.3f }%s\n",
+		   name, median * 1000, p99 * 1000, total * 1000, (last ? "" : ","));
+}
+
+
+int main(int argc, char* argv[])
+{
+	int		retval = 0;
+	@autoreleasepool {
+		const char*			words = DEFAULT_WORDS;
+		const char*			dict = NULL;
+		const char*			corpus = DEFAULT_CORPUS;
+		NSUInteger			repeats = DEFAULT_REPEATS;
+		QuipAttackOptions	options = QuipAttackSerial;
+		int					opt;
+		while ((opt = getopt(argc, argv, "pofr:c:w:d:")) != -1) {
+			switch (opt) {
+				case 'p':
+					options |= QuipAttackParallel;
+					break;
+				case 'o':
+					options |= QuipAttackDynamicOrder;
+					break;
+				case 'f':
+					options |= QuipAttackForwardCheck;
+					break;
+				case 'r':
+					repeats = (NSUInteger)strtoul(optarg, NULL, 10);
+					break;
+				case 'c':
+					corpus = optarg;
+					break;
+				case 'w':
+					words = optarg;
+					break;
+				case 'd':
+					dict = optarg;
+					break;
+				default:
+					fprintf(stderr, "usage: %s [-p] [-o] [-f] [-r repeats] [-c bench.quips] [-w words] [-d words.qdict]\n", argv[0]);
+					return 2;
+			}
+		}
+		if (repeats == 0) {
+			repeats = 1;
+		}
+
+		// load up the corpus - the hint, cyphertext and plaintext of each
+		NSString*		text = [NSString stringWithContentsOfFile:[NSString stringWithUTF8String:corpus] encoding:NSUTF8StringEncoding error:NULL];
+		if (text == nil) {
+			fprintf(stderr, "%s: unable to read the corpus from %s\n", argv[0], corpus);
+			return 1;
+		}
+		NSMutableArray*	quips = [NSMutableArray array];
+		for (NSString* line in [text componentsSeparatedByString:@"\n"]) {
+			NSArray*	fields = [line componentsSeparatedByString:@"\t"];
+			if (([line length] == 0) || [line hasPrefix:@"#"]) {
+				continue;
+			}
+			unichar		cypher, plain;
+			if (([fields count] != 3) || !parseHint([fields objectAtIndex:0], &cypher, &plain)) {
+				fprintf(stderr, "%s: unable to parse the quip '%s' in %s\n", argv[0], [line UTF8String], corpus);
+				return 1;
+			}
+			[quips addObject:fields];
+		}
+		NSUInteger		count = [quips count];
+		if (count == 0) {
+			fprintf(stderr, "%s: there are no quips in %s\n", argv[0], corpus);
+			return 1;
+		}
+
+		// load up the words - compiling them if we need to
+		NSString*		wordsFile = [NSString stringWithUTF8String:words];
+		NSString*		dictFile = (dict != NULL ? [NSString stringWithUTF8String:dict] :
+									[wordsFile stringByAppendingPathExtension:@"qdict"]);
+		NSTimeInterval	begin = [NSDate timeIntervalSinceReferenceDate];
+		PatternIndex*	index = [PatternIndex createPatternIndexForWordsFile:wordsFile compiledTo:dictFile];
+		NSTimeInterval	loaded = [NSDate timeIntervalSinceReferenceDate];
+		if (index == nil) {
+			fprintf(stderr, "%s: unable to load the words from %s\n", argv[0], words);
+			return 1;
+		}
+
+		// run them all, as many times as we're asked, keeping all the times
+		NSUInteger		runs = count * repeats;
+		double*			setup = calloc(runs, sizeof(double));
+		double*			prepare = calloc(runs, sizeof(double));
+		double*			search = calloc(runs, sizeof(double));
+		double*			total = calloc(runs, sizeof(double));
+		if ((setup == NULL) || (prepare == NULL) || (search == NULL) || (total == NULL)) {
+			fprintf(stderr, "%s: unable to allocate the times for %lu runs\n", argv[0], (unsigned long)runs);
+			return 1;
+		}
+		uint64_t		nodes = 0;
+		double			searching = 0.0;
+		NSUInteger		solved = 0;
+		NSUInteger		correct = 0;
+		NSMutableArray*	wrong = [NSMutableArray array];
+		NSUInteger		run = 0;
+		for (NSUInteger r = 0; r < repeats; ++r) {
+			for (NSUInteger i = 0; i < count; ++i, ++run) {
+				@autoreleasepool {
+					NSArray*		fields = [quips objectAtIndex:i];
+					unichar			cypher, plain;
+					parseHint([fields objectAtIndex:0], &cypher, &plain);
+					NSTimeInterval	start = [NSDate timeIntervalSinceReferenceDate];
+					Quip*			q = [[Quip alloc] initWithCypherText:[fields objectAtIndex:1] where:cypher equals:plain usingIndex:index];
+					NSTimeInterval	built = [NSDate timeIntervalSinceReferenceDate];
+					BOOL			ok = [q attemptWordBlockAttackWithOptions:options];
+					NSTimeInterval	done = [NSDate timeIntervalSinceReferenceDate];
+
+					setup[run] = built - start;
+					prepare[run] = [q getPrepareTime];
+					search[run] = [q getSearchTime];
+					total[run] = done - start;
+					nodes += [q getNodeCount];
+					searching += [q getSearchTime];
+
+					// only count the right answers the first time through
+					if (r == 0) {
+						BOOL	right = NO;
+						for (NSString* sol in [q getSolutions]) {
+							if ([sol caseInsensitiveCompare:[fields objectAtIndex:2]] == NSOrderedSame) {
+								right = YES;
+							}
+						}
+						solved += (ok ? 1 : 0);
+						correct += (right ? 1 : 0);
+						if (!right) {
+							[wrong addObject:[NSNumber numberWithUnsignedInteger:(i + 1)]];
+						}
+					}
+				}
+			}
+		}
+
+		// ...and write it all out as JSON
+		printf("{\n");
+		printf("  \"corpus\": \"%s\",\n", corpus);
+		printf("  \"quips\": %lu,\n", (unsigned long)count);
+		printf("  \"repeats\": %lu,\n", (unsigned long)repeats);
+		printf("  \"options\": { \"parallel\": %s, \"dynamic_order\": %s, \"forward_check\": %s },\n",
+			   ((options & QuipAttackParallel) ? "true" : "false"),
+			   ((options & QuipAttackDynamicOrder) ? "true" : "false"),
+			   ((options & QuipAttackForwardCheck) ? "true" : "false"));
+		printf("  \"filter\": \"%s\",\n", mk_filter_name());
+		printf("  \"dictionary\": { \"words\": %lu, \"load_ms\": %.3f },\n",
+			   (unsigned long)[index getWordCount], (loaded - begin) * 1000);
+		printf("  \"phases\": {\n");
+		printPhase("setup", setup, runs, NO);
+		printPhase("prepare", prepare, runs, NO);
+		printPhase("search", search, runs, NO);
+		printPhase("total", total, runs, YES);
+		printf("  },\n");
+		printf("  \"nodes\": %llu,\n", (unsigned long long)nodes);
+		printf("  \"nodes_per_sec\": %.0f,\n", (searching > 0.0 ? nodes / searching : 0.0));
+		printf("  \"solved\": %lu,\n", (unsigned long)solved);
+		printf("  \"correct\": %lu,\n", (unsigned long)correct);
+		printf("  \"incorrect\": [");
+		for (NSUInteger i = 0; i < [wrong count]; ++i) {
+			printf("%s%lu", (i > 0 ? ", " : ""), (unsigned long)[[wrong objectAtIndex:i] unsignedIntegerValue]);
+		}
+		printf("]\n");
+		printf("}\n");
+		fflush(stdout);
+
+		free(setup);
+		free(prepare);
+		free(search);
+		free(total);
+		if (correct != count) {
+			retval = 1;
+		}
+	}
+	return retval;
+}
@@ -0,0 +1,689 @@
+//
+//  quipd.m
+//  CryptoQuip
+//
+//  Created by Bob Beaty on 6/15/10.
+//  Copyright 2010 The Man from S.P.U.D. All rights reserved.
+//
+
+// Apple Headers
+#import <Foundation/Foundation.h>
+
+// System Headers
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Third Party Headers
+
+// Other Headers
+
+// Class Headers
+#import "Quip.h"
+#import "PatternIndex.h"
+#import "SolutionCache.h"
+#import "WorkPool.h"
+
+// Private Constants
+#define DEFAULT_WORDS		"words"
+#define DEFAULT_SOCKET		"/tmp/quipd.sock"
+#define MAX_FRAME			65536
+#define SEND_TIMEOUT		10
+#define LISTEN_BACKLOG		64
+#define CACHE_CAPACITY		10000
+#define DEFAULT_BUDGET		30.0
+#define WATCH_INTERVAL		0.1
+
+
+/*
+ * This is the resident solver. It loads the words - and their pattern index
+ * - once, and then takes puzzles over a Unix domain socket for as long as
+ * it's up, so each solve is just the search, and not the start-up:
+ *
+ *   quipd [-o] [-f] [-t secs] [-s /tmp/quipd.sock] [-C cache] [-w words] [-d words.qdict]
+ *
+ * Everything on the socket - both ways - is a frame: a 4-byte length, in
+ * network byte order, and then that many bytes of UTF-8 text, which is tab-
+ * separated fields. A request is:
+ *
+ *   <id> <hint> <cyphertext> [<limit>]
+ *
+ * where the id is anything the client wants to tell the answers apart by,
+ * the hint is something like 'b=t', and the limit is the most solutions to
+ * look for - one if it's not there, and zero for all of them. What comes
+ * back for each request is zero or more of:
+ *
+ *   solution <id> <plaintext>
+ *
+ * as they are found, and then one of:
+ *
+ *   done <id> solve_ms=<ms> solutions=<count> cache=<hit|miss> finished=<yes|no>
+ *   error <id> <message>
+ *
+ * Each search has '-t' seconds - 30 if it's not given, and zero for no end
+ * at all - and if it runs out, it stops, and what it found is all there is,
+ * with 'finished=no' to say there might have been more. A frame that's too
+ * big, or isn't UTF-8, gets an error - with an empty id, as we never got
+ * that far - and then the connection is closed, as there's no telling where
+ * the next frame would start.
+ *
+ * Every quip that's solved goes in the cache, so the same quip again - even
+ * encyphered with a different key - is answered without a search. With '-C'
+ * the cache is loaded from, and saved to, that file - every so often, and
+ * when we're stopped with SIGINT or SIGTERM - so it's still there after a
+ * restart.
+ *
+ * A client can send as many requests as it likes without waiting. Each one
+ * is handed to the workers as soon as it's read - up to as many at a time,
+ * for each connection, as there are workers - so a slow one doesn't hold up
+ * the ones behind it. The answers are sent as they're ready, so they can
+ * come back in any order - that's what the id is for. They are sent by the
+ * connection's own writer thread, so a client that's slow to read them only
+ * slows itself, and if it takes more than SEND_TIMEOUT seconds to take one
+ * frame, it's dropped, and its searches are stopped.
+ */
+
+
+/*
+ * These are what all the connections share - the words, the options and
+ * the budget for the attacks, and the cache of what's been solved. They
+ * are set up before the first connection, and never change after that -
+ * the cache is safe to use from all the threads at once.
+ */
+static PatternIndex*		__index = nil;
+static QuipAttackOptions	__options = QuipAttackSerial;
+static SolutionCache*		__cache = nil;
+static NSTimeInterval		__budget = DEFAULT_BUDGET;
+
+/*
+ * These are the attacks that are running, each with the time it has to be
+ * done by - the watchdog thread cancels the ones that run past it.
+ */
+static NSMutableArray*		__running = nil;
+static NSLock*				__runningLock = nil;
+
+/*
+ * This is the pipe the signal handler writes to when it's time to stop.
+ * The accept loop waits on it along with the socket, so it sees it right
+ * away - whichever thread the signal was delivered to.
+ */
+static int					__stopPipe[2] = { -1, -1 };
+
+
+/*
+ * This is just something for NSThread to start our threads on, so that
+ * they are threads the Foundation knows about - with all the set up that
+ * needs - and not bare pthreads.
+ */
+@interface QuipdThreads : NSObject
++ (void) serveConnection:(NSNumber*)fd;
++ (void) watchDeadlines:(id)unused;
+@end
+
+
+/*
+ * This is one client's connection. The solves on it never write to the
+ * socket themselves - they queue their frames here, and the connection's
+ * one writer thread sends them, in order - so a client that's slow to read
+ * only ever holds up its own writer, and never a worker, or the lock of a
+ * quip that's being solved. Each write has SEND_TIMEOUT seconds, and if it
+ * runs out, the connection is broken: what's still queued is dropped, the
+ * reading stops, and the solves still running on it are told so - by -send:
+ * returning NO - and can give up.
+ */
+@interface QuipdConnection : NSObject {
+	@private
+	// this is the client's socket
+	int					_fd;
+	// ...this guards all the rest, and wakes up the writer and the reader
+	NSCondition*		_signal;
+	// ...these are the frames waiting to be written
+	NSMutableArray*		_frames;
+	// ...these are the requests being solved, and how many there can be
+	NSUInteger			_running;
+	NSUInteger			_maxRunning;
+	// ...and this is how it's going
+	BOOL				_reading;
+	BOOL				_broken;
+}
+
+/*!
+ This is the initializer for the connection on the socket 'fd' - which it
+ then owns, and closes when it's all done.
+ */
+- (id) initWithSocket:(int)fd;
+
+/*!
+ This method reads requests off the socket, and hands each to the WorkPool,
+ until the client closes its end, or the connection breaks. It then waits
+ for the ones still running, and the writer to send all they found, and
+ only then returns.
+ */
+- (void) serve;
+
+/*!
+ This method queues the text as a frame for the writer, and returns YES -
+ or NO, if the connection is broken, and it's not going anywhere.
+ */
+- (BOOL) send:(NSString*)text;
+
+/*!
+ This is the writer thread for the connection. It sends the frames as they
+ are queued, and when the reading is done, and the queue is empty, it closes
+ the socket.
+ */
+- (void) writeFrames:(id)unused;
+
+@end
+
+
+/*
+ * This function reads exactly 'len' bytes from the socket - or returns NO
+ * if the socket is closed, or has an error, before that.
+ */
+static BOOL readFully(int fd, void* buff, size_t len)
+{
+	uint8_t*	p = buff;
+	while (len > 0) {
+		ssize_t		n = read(fd, p, len);
+		if (n > 0) {
+			p += n;
+			len -= (size_t)n;
+		} else if ((n < 0) && (errno == EINTR)) {
+			continue;
+		} else {
+			return NO;
+		}
+	}
+	return YES;
+}
+
+
+/*
+ * This function writes exactly 'len' bytes to the socket - or returns NO
+ * if it can't.
+ */
+static BOOL writeFully(int fd, const void* buff, size_t len)
+{
+	const uint8_t*	p = buff;
+	while (len > 0) {
+		ssize_t		n = write(fd, p, len);
+		if (n > 0) {
+			p += n;
+			len -= (size_t)n;
+		} else if ((n < 0) && (errno == EINTR)) {
+			continue;
+		} else {
+			return NO;
+		}
+	}
+	return YES;
+}
+
+
+/*
+ * This function solves the one request, and queues its solutions on the
+ * connection as they are found, and then how it all went. The search is put
+ * on the list for the watchdog while it runs, so it's stopped if it goes
+ * over budget - and it stops on its own if the connection breaks.
+ */
+static void solveRequest(QuipdConnection* conn, NSString* request)
+{
+	@autoreleasepool {
+		NSArray*	fields = [request componentsSeparatedByString:@"\t"];
+		NSString*	rid = ([fields count] > 0 ? [fields objectAtIndex:0] : @"");
+		NSString*	hint = ([fields count] > 1 ? [fields objectAtIndex:1] : @"");
+		if (([fields count] < 3) || ([fields count] > 4) || ([hint length] != 3) ||
+			([hint characterAtIndex:1] != '=') ||
+			([hint characterAtIndex:0] >= 0x80) || !isalpha([hint characterAtIndex:0]) ||
+			([hint characterAtIndex:2] >= 0x80) || !isalpha([hint characterAtIndex:2])) {
+			[conn send:[NSString stringWithFormat:@"error\t%@\tunable to parse the request", rid]];
+			return;
+		}
+		unichar		cypher = tolower([hint characterAtIndex:0]);
+		unichar		plain = tolower([hint characterAtIndex:2]);
+		NSInteger	wanted = 1;
+		if ([fields count] > 3) {
+			NSScanner*	scan = [NSScanner scannerWithString:[fields objectAtIndex:3]];
+			if (![scan scanInteger:&wanted] || ![scan isAtEnd] || (wanted < 0)) {
+				[conn send:[NSString stringWithFormat:@"error\t%@\tthe limit must be zero, or a positive number", rid]];
+				return;
+			}
+		}
+		NSUInteger	limit = (NSUInteger)wanted;
+
+		NSString*		cyphertext = [fields objectAtIndex:2];
+		NSTimeInterval	begin = [NSDate timeIntervalSinceReferenceDate];
+		NSArray*		cached = [__cache solutionsForCypherText:cyphertext where:cypher equals:plain limit:limit];
+		NSUInteger		count = 0;
+		BOOL			finished = YES;
+		if (cached != nil) {
+			for (Legend* legend in cached) {
+				[conn send:[NSString stringWithFormat:@"solution\t%@\t%@", rid, [legend decode:cyphertext]]];
+			}
+			count = [cached count];
+		} else {
+			Quip*		q = [[Quip alloc] initWithCypherText:cyphertext where:cypher equals:plain usingIndex:__index];
+			NSArray*	watch = [NSArray arrayWithObjects:q, [NSNumber numberWithDouble:(begin + __budget)], nil];
+			if (__budget > 0.0) {
+				[__runningLock lock];
+				[__running addObject:watch];
+				[__runningLock unlock];
+			}
+			[q attemptWordBlockAttackWithOptions:__options limit:limit solutionHandler:^(Legend* legend, NSString* plaintext) {
+				// ...no one's listening, so there's no point going on
+				if (![conn send:[NSString stringWithFormat:@"solution\t%@\t%@", rid, plaintext]]) {
+					[q cancelAttack];
+				}
+			}];
+			if (__budget > 0.0) {
+				[__runningLock lock];
+				[__running removeObjectIdenticalTo:watch];
+				[__runningLock unlock];
+			}
+			count = [[q getSolutions] count];
+			// it's cancelled if it's over budget, or the client's gone - but
+			// reaching the limit is finishing
+			finished = (![q isCancelled] || ((limit > 0) && (count >= limit)));
+			[__cache addSolutions:[q getSolutionKeys] forCypherText:cyphertext where:cypher equals:plain limit:limit finished:finished];
+		}
+		[conn send:[NSString stringWithFormat:@"done\t%@\tsolve_ms=%.3f\tsolutions=%lu\tcache=%s\tfinished=%s", rid,
+					([NSDate timeIntervalSinceReferenceDate] - begin) * 1000,
+					(unsigned long)count, (cached != nil ? "hit" : "miss"), (finished ? "yes" : "no")]];
+	}
+}
+
+
+/*
+ * This function is the handler for SIGINT and SIGTERM. All it can safely
+ * do is write to the pipe, and let the accept loop do the rest.
+ */
+static void stopServing(int sig)
+{
+	char	c = (char)sig;
+	if (write(__stopPipe[1], &c, 1) < 0) {
+		// ...there's nothing to be done about it in here
+	}
+}
+
+
+@implementation QuipdConnection
+
+/*!
+ This is the initializer for the connection on the socket 'fd' - which it
+ then owns, and closes when it's all done.
+ */
+- (id) initWithSocket:(int)fd
+{
+	if ((self = [super init])) {
+		_fd = fd;
+		_signal = [[NSCondition alloc] init];
+		_frames = [[NSMutableArray alloc] init];
+		_running = 0;
+		// ...one client can't have more than the whole pool
+		_maxRunning = [[WorkPool sharedWorkPool] getWorkerCount];
+		if (_maxRunning < 1) {
+			_maxRunning = 1;
+		}
+		_reading = YES;
+		_broken = NO;
+	}
+	return self;
+}
+
+
+/*!
+ This method reads the next frame from the socket, and returns it as a
+ string - or nil if the socket is closed, or the frame is bad. A bad one
+ gets an error frame, with an empty id, so the client knows it was turned
+ away, and didn't just see us fall over.
+ */
+- (NSString*) readFrame
+{
+	NSString*	frame = nil;
+	uint32_t	len = 0;
+	if (readFully(_fd, &len, sizeof(len))) {
+		len = ntohl(len);
+		if (len > MAX_FRAME) {
+			[self send:[NSString stringWithFormat:@"error\t\tthe frame of %lu bytes is over the %d byte limit",
+						(unsigned long)len, MAX_FRAME]];
+		} else {
+			char	buff[len + 1];
+			if (readFully(_fd, buff, len)) {
+				buff[len] = '\0';
+				frame = [NSString stringWithUTF8String:buff];
+				if (frame == nil) {
+					[self send:@"error\t\tthe frame is not UTF-8 text"];
+				}
+			}
+		}
+	}
+	return frame;
+}
+
+
+/*!
+ This method reads requests off the socket, and hands each to the WorkPool,
+ until the client closes its end, or the connection breaks. It then waits
+ for the ones still running, and the writer to send all they found, and
+ only then returns.
+ */
+- (void) serve
+{
+	[NSThread detachNewThreadSelector:@selector(writeFrames:) toTarget:self withObject:nil];
+	WorkPool*	pool = [WorkPool sharedWorkPool];
+	BOOL		more = YES;
+	while (more) {
+		@autoreleasepool {
+			NSString*	request = [self readFrame];
+			[_signal lock];
+			if ((request == nil) || _broken) {
+				more = NO;
+			} else {
+				// past the cap, we wait for one to finish before reading on
+				while ((_running >= _maxRunning) && !_broken) {
+					[_signal wait];
+				}
+				if (_broken) {
+					more = NO;
+				} else {
+					++_running;
+				}
+			}
+			[_signal unlock];
+			if (more) {
+				BOOL	added = [pool addTask:^{
+					solveRequest(self, request);
+					[_signal lock];
+					--_running;
+					[_signal broadcast];
+					[_signal unlock];
+				}];
+				if (!added) {
+					[_signal lock];
+					--_running;
+					[_signal unlock];
+					[self send:@"error\t\tthe server is shutting down"];
+					more = NO;
+				}
+			}
+		}
+	}
+	// ...the answers still to come need the writer
+	[_signal lock];
+	while (_running > 0) {
+		[_signal wait];
+	}
+	_reading = NO;
+	[_signal broadcast];
+	while (_fd >= 0) {
+		[_signal wait];
+	}
+	[_signal unlock];
+}
+
+
+/*!
+ This method queues the text as a frame for the writer, and returns YES -
+ or NO, if the connection is broken, and it's not going anywhere.
+ */
+- (BOOL) send:(NSString*)text
+{
+	const char*	utf = [text UTF8String];
+	size_t		len = strlen(utf);
+	uint32_t	head = htonl((uint32_t)len);
+	NSMutableData*	frame = [NSMutableData dataWithCapacity:(sizeof(head) + len)];
+	[frame appendBytes:&head length:sizeof(head)];
+	[frame appendBytes:utf length:len];
+
+	BOOL	ok = NO;
+	[_signal lock];
+	if (!_broken) {
+		[_frames addObject:frame];
+		[_signal broadcast];
+		ok = YES;
+	}
+	[_signal unlock];
+	return ok;
+}
+
+
+/*!
+ This is the writer thread for the connection. It sends the frames as they
+ are queued, and when the reading is done, and the queue is empty, it closes
+ the socket.
+ */
+- (void) writeFrames:(id)unused
+{
+	BOOL	more = YES;
+	while (more) {
+		@autoreleasepool {
+			NSData*		frame = nil;
+			[_signal lock];
+			while (([_frames count] == 0) && _reading) {
+				[_signal wait];
+			}
+			if ([_frames count] > 0) {
+				frame = [_frames objectAtIndex:0];
+				[_frames removeObjectAtIndex:0];
+			} else {
+				more = NO;
+			}
+			[_signal unlock];
+
+			if ((frame != nil) && !writeFully(_fd, [frame bytes], [frame length])) {
+				// ...the client's gone, or it's stopped reading, so we're done
+				[_signal lock];
+				_broken = YES;
+				[_frames removeAllObjects];
+				[_signal broadcast];
+				[_signal unlock];
+				shutdown(_fd, SHUT_RDWR);
+			}
+		}
+	}
+	[_signal lock];
+	close(_fd);
+	_fd = -1;
+	[_signal broadcast];
+	[_signal unlock];
+}
+
+@end
+
+
+@implementation QuipdThreads
+
+/*
+ * This is the thread for one connection - it just serves it, and it's done.
+ */
++ (void) serveConnection:(NSNumber*)fd
+{
+	@autoreleasepool {
+		QuipdConnection*	conn = [[QuipdConnection alloc] initWithSocket:[fd intValue]];
+		[conn serve];
+	}
+}
+
+
+/*
+ * This is the watchdog thread. Every so often, it looks over the attacks
+ * that are running, and cancels the ones that have used up their budget.
+ * They'll stop at the next word they try, and send back what they found.
+ */
++ (void) watchDeadlines:(id)unused
+{
+	while (YES) {
+		@autoreleasepool {
+			NSTimeInterval	now = [NSDate timeIntervalSinceReferenceDate];
+			[__runningLock lock];
+			for (NSArray* watch in __running) {
+				if (now >= [[watch objectAtIndex:1] doubleValue]) {
+					[[watch objectAtIndex:0] cancelAttack];
+				}
+			}
+			[__runningLock unlock];
+		}
+		[NSThread sleepForTimeInterval:WATCH_INTERVAL];
+	}
+}
+
+@end
+
+
+int main(int argc, char* argv[])
+{
+	int		retval = 0;
+	@autoreleasepool {
+		const char*		words = DEFAULT_WORDS;
+		const char*		dict = NULL;
+		const char*		path = DEFAULT_SOCKET;
+		const char*		cacheFile = NULL;
+		int				opt;
+		while ((opt = getopt(argc, argv, "oft:s:C:w:d:")) != -1) {
+			switch (opt) {
+				case 'o':
+					__options |= QuipAttackDynamicOrder;
+					break;
+				case 'f':
+					__options |= QuipAttackForwardCheck;
+					break;
+				case 't':
+					__budget = atof(optarg);
+					break;
+				case 's':
+					path = optarg;
+					break;
+				case 'C':
+					cacheFile = optarg;
+					break;
+				case 'w':
+					words = optarg;
+					break;
+				case 'd':
+					dict = optarg;
+					break;
+				default:
+					fprintf(stderr, "usage: %s [-o] [-f] [-t secs] [-s socket] [-C cache] [-w words] [-d words.qdict]\n", argv[0]);
+					return 2;
+			}
+		}
+
+		// load up the words once - this is what we're here to save
+		NSString*		wordsFile = [NSString stringWithUTF8String:words];
+		NSString*		dictFile = (dict != NULL ? [NSString stringWithUTF8String:dict] :
+									[wordsFile stringByAppendingPathExtension:@"qdict"]);
+		__index = [PatternIndex createPatternIndexForWordsFile:wordsFile compiledTo:dictFile];
+		if (__index == nil) {
+			fprintf(stderr, "%s: unable to load the words from %s\n", argv[0], words);
+			return 1;
+		}
+		// ...and the cache, from the last time if we were asked to keep it
+		__cache = (cacheFile != NULL ?
+				   [SolutionCache createSolutionCache:CACHE_CAPACITY withFile:[NSString stringWithUTF8String:cacheFile] forWordsFile:wordsFile] :
+				   [SolutionCache createSolutionCache:CACHE_CAPACITY]);
+		// ...and get the workers going before the first request
+		[WorkPool sharedWorkPool];
+		// ...and the watchdog, if the searches have a budget
+		__running = [[NSMutableArray alloc] init];
+		__runningLock = [[NSLock alloc] init];
+		if (__budget > 0.0) {
+			[NSThread detachNewThreadSelector:@selector(watchDeadlines:) toTarget:[QuipdThreads class] withObject:nil];
+		}
+
+		// a client going away while we're answering it is not our problem
+		signal(SIGPIPE, SIG_IGN);
+		// ...but being told to stop is, as the cache needs to be saved
+		if (pipe(__stopPipe) != 0) {
+			fprintf(stderr, "%s: unable to create the pipe for stopping - %s\n", argv[0], strerror(errno));
+			return 1;
+		}
+		signal(SIGINT, stopServing);
+		signal(SIGTERM, stopServing);
+
+		// set up the socket, clearing out anything left from the last time
+		struct sockaddr_un	addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (strlen(path) >= sizeof(addr.sun_path)) {
+			fprintf(stderr, "%s: the socket path %s is too long\n", argv[0], path);
+			return 1;
+		}
+		strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+		int		sock = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (sock < 0) {
+			fprintf(stderr, "%s: unable to create the socket - %s\n", argv[0], strerror(errno));
+			return 1;
+		}
+		unlink(path);
+		if ((bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+			(listen(sock, LISTEN_BACKLOG) != 0)) {
+			fprintf(stderr, "%s: unable to listen on %s - %s\n", argv[0], path, strerror(errno));
+			close(sock);
+			return 1;
+		}
+		printf("listening\t%s\twords=%lu\tcached=%lu\n", path, (unsigned long)[__index getWordCount],
+			   (unsigned long)[__cache getCount]);
+		fflush(stdout);
+
+		// each connection gets its own thread to read its requests
+		BOOL	serving = YES;
+		while (serving) {
+			struct pollfd	pfd[2];
+			pfd[0].fd = sock;
+			pfd[0].events = POLLIN;
+			pfd[0].revents = 0;
+			pfd[1].fd = __stopPipe[0];
+			pfd[1].events = POLLIN;
+			pfd[1].revents = 0;
+			if (poll(pfd, 2, -1) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				fprintf(stderr, "%s: unable to wait for a connection - %s\n", argv[0], strerror(errno));
+				retval = 1;
+				break;
+			}
+			if (pfd[1].revents & POLLIN) {
+				// we've been told to stop
+				serving = NO;
+			} else if (pfd[0].revents & POLLIN) {
+				int		fd = accept(sock, NULL, NULL);
+				if (fd < 0) {
+					if ((errno == EINTR) || (errno == ECONNABORTED)) {
+						continue;
+					}
+					fprintf(stderr, "%s: unable to accept a connection - %s\n", argv[0], strerror(errno));
+					retval = 1;
+					break;
+				}
+				// ...a client that stops reading can't hold up its writer for good
+				struct timeval	tv = { SEND_TIMEOUT, 0 };
+				if (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0) {
+					fprintf(stderr, "%s: unable to set the send timeout on a connection - %s\n", argv[0], strerror(errno));
+				}
+				[NSThread detachNewThreadSelector:@selector(serveConnection:) toTarget:[QuipdThreads class]
+									   withObject:[NSNumber numberWithInt:fd]];
+			}
+		}
+		close(sock);
+		unlink(path);
+		// ...and keep what we've solved for the next time
+		if (![__cache save]) {
+			retval = 1;
+		}
+		printf("stopped\t%s\tcached=%lu\thits=%lu\tmisses=%lu\n", path, (unsigned long)[__cache getCount],
+			   (unsigned long)[__cache getHits], (unsigned long)[__cache getMisses]);
+		fflush(stdout);
+	}
+	return retval;
+}